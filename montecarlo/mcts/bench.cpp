@@ -0,0 +1,84 @@
+// Times the search core on its own, without evaluators, for each game it is built for.
+// Build: g++ -O2 -std=c++17 -pthread bench.cpp board.cpp epoch.cpp mcts.cpp node_arena.cpp thread_pool.cpp tictactoe.cpp -o bench
+// Usage: ./bench game=board iterations=100000 repeats=5 selection=puct
+// game is board (ultimate tic-tac-toe) or tictactoe; selection is puct, uct or ucb1tuned.
+#include "board.h"
+#include "mcts.h"
+#include "tictactoe.h"
+#include <string>
+
+using std::string;
+
+// Search the starting position from an empty tree repeats times and report the iteration rate,
+// then play one game of the engine against itself.
+template <typename Game> void bench(search_config settings, int repeats) {
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        GameTree<Game> tree;
+        tree.verbose = false;
+        tree.config.c = settings.c;
+        tree.config.selection = settings.selection;
+        auto start = std::chrono::steady_clock::now();
+        tree.mcts(Game(), settings.iterations);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%d iterations in %.3f s: %.0f iterations/s, %d nodes, %.1f KiB\n", settings.iterations,
+               elapsed.count(), settings.iterations / elapsed.count(), tree.transposition_size(),
+               tree.memory_usage() / 1024.0);
+    }
+    GameTree<Game> tree;
+    tree.verbose = false;
+    tree.config.iterations = settings.iterations;
+    tree.config.c = settings.c;
+    tree.config.selection = settings.selection;
+    tree.new_game();
+    int moves = 0;
+    while (tree.position.game_winner() == PLAYER_NONE) {
+        if (!tree.apply_move(tree.choose_move(tree.position, tree.position_root()))) {
+            printf("Self-play: search returned an illegal move after %d moves!\n", moves);
+            return;
+        }
+        moves++;
+    }
+    char winner = tree.position.game_winner();
+    printf("Self-play: %s after %d moves\n", winner == PLAYER_TIE ? "tie" : (winner == PLAYER_X ? "X wins" : "O wins"),
+           moves);
+}
+
+int main(int argc, char **argv) {
+    search_config settings;
+    settings.iterations = 100000;
+    string game = "board";
+    int repeats = 5;
+    for (int arg = 1; arg < argc; arg++) {
+        string setting(argv[arg]);
+        size_t eq = setting.find('=');
+        string key = setting.substr(0, eq);
+        string value = eq == string::npos ? "" : setting.substr(eq + 1);
+        if (key == "game") {
+            game = value;
+        } else if (key == "iterations") {
+            settings.iterations = std::stoi(value);
+        } else if (key == "repeats") {
+            repeats = std::stoi(value);
+        } else if (key == "c") {
+            settings.c = std::stof(value);
+        } else if (key == "selection" && value == "puct") {
+            settings.selection = SELECT_PUCT;
+        } else if (key == "selection" && value == "uct") {
+            settings.selection = SELECT_UCT;
+        } else if (key == "selection" && value == "ucb1tuned") {
+            settings.selection = SELECT_UCB1_TUNED;
+        } else {
+            printf("Unknown setting %s\n", argv[arg]);
+            return 1;
+        }
+    }
+    if (game == "board") {
+        bench<Board>(settings, repeats);
+    } else if (game == "tictactoe") {
+        bench<TicTacToe>(settings, repeats);
+    } else {
+        printf("Unknown game %s\n", game.c_str());
+        return 1;
+    }
+    return 0;
+}
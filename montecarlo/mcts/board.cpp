@@ -42,37 +42,84 @@ char grid_winner(const char grid[3][3]) {
     return PLAYER_NONE;
 }
 
-char grid_winner(const char grid[9][9], int m_i, int m_j) {
-    int nonzero_count = 0;
-    for (int i = 0; i < 3; i++) {
-        int row_sum = 0;
-        int col_sum = 0;
-        for (int j = 0; j < 3; j++) {
-            row_sum += grid[3 * m_i + i][j + 3 * m_j];
-            col_sum += grid[3 * m_i + j][i + 3 * m_j];
-            nonzero_count += grid[3 * m_i + i][j + 3 * m_j] ? 1 : 0;
-        }
-        if (row_sum == 3 * PLAYER_X || col_sum == 3 * PLAYER_X) {
-            return PLAYER_X;
+const unsigned short POW3[9] = {1, 3, 9, 27, 81, 243, 729, 2187, 6561};
+const int TILE_LINES[8][3] = {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}, {0, 3, 6}, {1, 4, 7}, {2, 5, 8}, {0, 4, 8}, {2, 4, 6}};
+
+tile_info TILE_TABLE[TILE_STATES];
+
+// Fill TILE_TABLE by decoding every index once at startup.
+bool build_tile_table() {
+    for (int index = 0; index < TILE_STATES; index++) {
+        char grid[3][3];
+        char cells[9];
+        tile_info &info = TILE_TABLE[index];
+        info.empty = 0;
+        info.swapped = 0;
+        for (int k = 0, rest = index; k < 9; k++, rest /= 3) {
+            int digit = rest % 3;
+            cells[k] = digit == 0 ? PLAYER_NONE : (digit == 1 ? PLAYER_X : PLAYER_O);
+            grid[k / 3][k % 3] = cells[k];
+            info.empty |= digit == 0 ? 1 << k : 0;
+            info.swapped += (digit == 0 ? 0 : 3 - digit) * POW3[k];
         }
-        if (row_sum == 3 * PLAYER_O || col_sum == 3 * PLAYER_O) {
-            return PLAYER_O;
+        info.winner = grid_winner(grid);
+        info.x_wins = 0;
+        info.o_wins = 0;
+        bool open_line = false;
+        for (const int *line : TILE_LINES) {
+            int x_count = 0;
+            int o_count = 0;
+            int empty_cell = -1;
+            for (int k = 0; k < 3; k++) {
+                x_count += cells[line[k]] == PLAYER_X;
+                o_count += cells[line[k]] == PLAYER_O;
+                empty_cell = cells[line[k]] == PLAYER_NONE ? line[k] : empty_cell;
+            }
+            open_line = open_line || x_count == 0 || o_count == 0;
+            if (x_count == 2 && o_count == 0) {
+                info.x_wins |= 1 << empty_cell;
+            }
+            if (o_count == 2 && x_count == 0) {
+                info.o_wins |= 1 << empty_cell;
+            }
         }
+        info.dead = info.winner != PLAYER_NONE || !open_line;
     }
-    int diag_sum_1 = grid[3 * m_i][3 * m_j] + grid[3 * m_i + 1][3 * m_j + 1] + grid[3 * m_i + 2][3 * m_j + 2];
-    int diag_sum_2 = grid[3 * m_i][3 * m_j + 2] + grid[3 * m_i + 1][3 * m_j + 1] + grid[3 * m_i + 2][3 * m_j];
-    if (diag_sum_1 == 3 * PLAYER_X || diag_sum_2 == 3 * PLAYER_X) {
-        return PLAYER_X;
-    }
-    if (diag_sum_1 == 3 * PLAYER_O || diag_sum_2 == 3 * PLAYER_O) {
-        return PLAYER_O;
+    return true;
+}
+
+const bool tile_table_ready = build_tile_table();
+
+unsigned short ALLOWED_TILES[10][512];
+
+bool build_allowed_tiles() {
+    for (int closed = 0; closed < 512; closed++) {
+        unsigned short open = ~closed & 0x1ff;
+        for (int forced = 0; forced < 9; forced++) {
+            ALLOWED_TILES[forced][closed] = (open >> forced) & 1 ? 1 << forced : open;
+        }
+        ALLOWED_TILES[9][closed] = open;
     }
-    if (nonzero_count == 3 * 3) {
-        return PLAYER_TIE;
+    return true;
+}
+
+const bool allowed_tiles_ready = build_allowed_tiles();
+
+bool HAS_LINE[512];
+
+bool build_has_line() {
+    for (int mask = 0; mask < 512; mask++) {
+        HAS_LINE[mask] = false;
+        for (const int *line : TILE_LINES) {
+            int line_mask = (1 << line[0]) | (1 << line[1]) | (1 << line[2]);
+            HAS_LINE[mask] = HAS_LINE[mask] || (mask & line_mask) == line_mask;
+        }
     }
-    return PLAYER_NONE;
+    return true;
 }
 
+const bool has_line_ready = build_has_line();
+
 bool is_unset(supergrid_coord tile) { return (tile.i == -1) && (tile.j == -1); }
 
 Board::Board() {}
@@ -83,9 +130,17 @@ Board::Board(const Board &other) {
             board[i][j] = other.board[i][j];
         }
     }
+    for (int m_i = 0; m_i < 3; m_i++) {
+        for (int m_j = 0; m_j < 3; m_j++) {
+            supergrid[m_i][m_j] = other.supergrid[m_i][m_j];
+            tile_index[m_i][m_j] = other.tile_index[m_i][m_j];
+        }
+    }
+    closed = other.closed;
+    x_tiles = other.x_tiles;
+    o_tiles = other.o_tiles;
     player = other.player;
     major_tile = other.major_tile;
-    update_supergrid();
 }
 
 Board::Board(const char grid[9][9], const int active_player, const supergrid_coord active_tile) {
@@ -99,45 +154,62 @@ Board::Board(const char grid[9][9], const int active_player, const supergrid_coo
     update_supergrid();
 }
 
-char Board::game_winner() const { return grid_winner(supergrid); }
+// The winner as grid_winner would find it in the supergrid, from the masks of won and closed tiles.
+char Board::game_winner() const {
+    if (HAS_LINE[x_tiles]) {
+        return PLAYER_X;
+    }
+    if (HAS_LINE[o_tiles]) {
+        return PLAYER_O;
+    }
+    return closed == 0x1ff ? PLAYER_TIE : PLAYER_NONE;
+}
 
-vector<grid_coord> Board::get_valid_moves() const {
-    if (game_winner() == PLAYER_TIE) {
-        return vector<grid_coord>();
-    }
-    vector<grid_coord> moves;
-    if (is_unset(major_tile)) {
-        for (int i = 0; i < 9; i++) {
-            for (int j = 0; j < 9; j++) {
-                if(supergrid[i/3][j/3] != PLAYER_NONE){
-                    continue;
-                }
-                if (board[i][j] == PLAYER_NONE) {
-                    moves.push_back(grid_coord{.m_i = i / 3, .m_j = j / 3, .i = i % 3, .j = j % 3});
-                }
-            }
-        }
-    } else {
-        for (int i = major_tile.i * 3; i < major_tile.i * 3 + 3; i++) {
-            for (int j = major_tile.j * 3; j < major_tile.j * 3 + 3; j++) {
-                if (board[i][j] == PLAYER_NONE) {
-                    moves.push_back(grid_coord{.m_i = i / 3, .m_j = j / 3, .i = i % 3, .j = j % 3});
-                }
-            }
+// The mask of tiles the player to move may play in, or 0 once the game is decided.
+unsigned short Board::allowed_tiles() const {
+    if (game_winner() != PLAYER_NONE) {
+        return 0;
+    }
+    int forced = is_unset(major_tile) ? 9 : 3 * major_tile.i + major_tile.j;
+    return ALLOWED_TILES[forced][closed];
+}
+
+// Write every legal move into moves and return how many there are.
+// Each allowed tile contributes its empty-cell mask, so no cell is looked at twice.
+int Board::get_valid_moves(grid_coord moves[81]) const {
+    int count = 0;
+    for (unsigned tiles = allowed_tiles(); tiles != 0; tiles &= tiles - 1) {
+        int tile = __builtin_ctz(tiles);
+        for (unsigned cells = TILE_TABLE[tile_index[tile / 3][tile % 3]].empty; cells != 0; cells &= cells - 1) {
+            int cell = __builtin_ctz(cells);
+            moves[count++] = grid_coord{.m_i = tile / 3, .m_j = tile % 3, .i = cell / 3, .j = cell % 3};
         }
     }
-    return moves;
+    return count;
+}
+
+vector<grid_coord> Board::get_valid_moves() const {
+    grid_coord moves[81];
+    int count = get_valid_moves(moves);
+    return vector<grid_coord>(moves, moves + count);
 }
 
+// Coordinates out of range, as unpacked moves can hold, are rejected before anything is indexed with them.
 bool Board::is_valid_move(const grid_coord &move) const {
-    int i = move.i;
-    int j = move.j;
-    int m_i = move.m_i;
-    int m_j = move.m_j;
-    if (is_unset(major_tile)) {
-        return board[i + 3 * m_i][j + 3 * m_j] == PLAYER_NONE;
+    if (move.m_i < 0 || move.m_i > 2 || move.m_j < 0 || move.m_j > 2 || move.i < 0 || move.i > 2 || move.j < 0 ||
+        move.j > 2) {
+        return false;
     }
-    return board[i + 3 * m_i][j + 3 * m_j] == PLAYER_NONE && (major_tile.i == m_i || major_tile.j == m_j);
+    int tile = 3 * move.m_i + move.m_j;
+    int cell = 3 * move.i + move.j;
+    return (allowed_tiles() >> tile) & 1 && (TILE_TABLE[tile_index[move.m_i][move.m_j]].empty >> cell) & 1;
+}
+
+// Check whether playing the move would win its tile for the player to move.
+bool Board::wins_tile(const grid_coord &move) const {
+    const tile_info &info = tile(move.m_i, move.m_j);
+    unsigned short wins = player == PLAYER_X ? info.x_wins : info.o_wins;
+    return (wins >> (3 * move.i + move.j)) & 1;
 }
 
 bool Board::move(const grid_coord &move) {
@@ -151,7 +223,12 @@ bool Board::move(const grid_coord &move) {
     int g_i = m_i * 3 + i;
     int g_j = m_j * 3 + j;
     board[g_i][g_j] = player;
-    update_supergrid(m_i, m_j);
+    tile_index[m_i][m_j] += (player == PLAYER_X ? 1 : 2) * POW3[3 * i + j];
+    char winner = TILE_TABLE[tile_index[m_i][m_j]].winner;
+    supergrid[m_i][m_j] = winner;
+    closed |= (winner != PLAYER_NONE) << (3 * m_i + m_j);
+    x_tiles |= (winner == PLAYER_X) << (3 * m_i + m_j);
+    o_tiles |= (winner == PLAYER_O) << (3 * m_i + m_j);
     if (supergrid[i][j] != PLAYER_NONE) {
         major_tile = {.i = -1, .j = -1};
     } else {
@@ -161,13 +238,32 @@ bool Board::move(const grid_coord &move) {
     return true;
 }
 
-void Board::update_supergrid(int m_i, int m_j) { supergrid[m_i][m_j] = grid_winner(board, m_i, m_j); }
+// Compute the base 3 index of one tile of the grid.
+unsigned short grid_index(const char grid[9][9], int m_i, int m_j) {
+    unsigned short index = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            char cell = grid[3 * m_i + i][3 * m_j + j];
+            index += (cell == PLAYER_X ? 1 : (cell == PLAYER_O ? 2 : 0)) * POW3[3 * i + j];
+        }
+    }
+    return index;
+}
 
+// Recompute every tile index, the supergrid and its masks from the cells.
 void Board::update_supergrid() {
-    for (int m_i = 0; m_i < 3; m_i++) {
-        for (int m_j = 0; m_j < 3; m_j++) {
-            supergrid[m_i][m_j] = grid_winner(board, m_i, m_j);
-        }
+    closed = 0;
+    x_tiles = 0;
+    o_tiles = 0;
+    for (int tile = 0; tile < 9; tile++) {
+        int m_i = tile / 3;
+        int m_j = tile % 3;
+        tile_index[m_i][m_j] = grid_index(board, m_i, m_j);
+        char winner = TILE_TABLE[tile_index[m_i][m_j]].winner;
+        supergrid[m_i][m_j] = winner;
+        closed |= (winner != PLAYER_NONE) << tile;
+        x_tiles |= (winner == PLAYER_X) << tile;
+        o_tiles |= (winner == PLAYER_O) << tile;
     }
 }
 
@@ -226,6 +322,23 @@ void Board::print() {
     cout << endl;
 }
 
+// Mix the tile indices, which determine the grid, with the side to move and the forced tile, splitmix64 style.
+unsigned long long Board::hash(unsigned long long seed) const {
+    unsigned long long h = seed;
+    auto mix = [&h](unsigned long long value) {
+        h = (h ^ value) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+    };
+    for (int m_i = 0; m_i < 3; m_i++) {
+        mix((unsigned long long)tile_index[m_i][0] << 32 | (unsigned long long)tile_index[m_i][1] << 16 |
+            tile_index[m_i][2]);
+    }
+    mix((unsigned long long)(unsigned char)player << 16 | (unsigned char)major_tile.i << 8 |
+        (unsigned char)major_tile.j);
+    return h;
+}
+
 bool Board::operator==(const Board &other) const {
     for (int i = 0; i < 9; i++) {
         for (int j = 0; j < 9; j++) {
@@ -234,5 +347,5 @@ bool Board::operator==(const Board &other) const {
             }
         }
     }
-    return player == other.player;
+    return player == other.player && major_tile.i == other.major_tile.i && major_tile.j == other.major_tile.j;
 }
\ No newline at end of file
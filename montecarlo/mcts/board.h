@@ -23,28 +23,68 @@ const char PLAYER_X = -1;
 const char PLAYER_O = 1;
 const char PLAYER_TIE = 100;
 
+// Everything about a single 3x3 tile that only depends on its cells.
+// Tiles are indexed in base 3 with cell (i, j) as digit 3 * i + j, valued 0 when empty, 1 for X and 2 for O.
+// Cell masks use the same bit order.
+const int TILE_STATES = 19683;
+typedef struct _tile_info {
+    char winner;             // As grid_winner: a player, PLAYER_TIE when full, or PLAYER_NONE.
+    bool dead;               // Decided, or neither player can complete a line any more.
+    unsigned short x_wins;   // Empty cells that complete a line for X.
+    unsigned short o_wins;   // Empty cells that complete a line for O.
+    unsigned short empty;    // Empty cells.
+    unsigned short swapped;  // Index of the same tile with X and O exchanged.
+} tile_info;
+
+extern tile_info TILE_TABLE[TILE_STATES];
+extern const unsigned short POW3[9];
+
+// Tiles a move may be played in, by forced tile (3 * i + j, or 9 for a free move) and the mask of closed tiles.
+// A forced tile that is closed turns into a free move over every open tile.
+extern unsigned short ALLOWED_TILES[10][512];
+
+// Whether a mask of cells, in tile bit order, holds a whole row, column or diagonal.
+extern bool HAS_LINE[512];
+
 class Board {
   public:
+    typedef grid_coord move_type;
+    static const int MAX_MOVES = 81;
+    static constexpr grid_coord NO_MOVE = {-1, -1, -1, -1};
+    // Index of a move's cell in the full 9x9 grid.
+    static int move_index(const grid_coord &move) { return 9 * (3 * move.m_i + move.i) + 3 * move.m_j + move.j; }
     Board(const Board &other);
     Board(const char grid[9][9], const int active_player, const supergrid_coord active_tile);
     Board();
     vector<grid_coord> get_valid_moves() const;
+    int get_valid_moves(grid_coord moves[81]) const;
+    unsigned short allowed_tiles() const;
     char game_winner() const;
     bool is_valid_move(const grid_coord &move) const;
+    bool wins_tile(const grid_coord &move) const;
+    const tile_info &tile(int m_i, int m_j) const { return TILE_TABLE[tile_index[m_i][m_j]]; }
     bool move(const grid_coord &move);
     void print();
     bool operator==(const Board &other) const;
+    // Two independent 64 bit hashes of the position, for tables that key by one and verify with the other.
+    unsigned long long key() const { return hash(0x9e3779b97f4a7c15ULL); }
+    unsigned long long check() const { return hash(0xc2b2ae3d27d4eb4fULL); }
     char board[9][9] = {PLAYER_NONE};
     char supergrid[3][3] = {PLAYER_NONE};
+    unsigned short tile_index[3][3] = {{0}};
+    unsigned short closed = 0; // Tiles that are won or full, bit 3 * m_i + m_j.
+    unsigned short x_tiles = 0; // Tiles won by X, in the same bit order.
+    unsigned short o_tiles = 0; // Tiles won by O.
     char player = PLAYER_X;
     supergrid_coord major_tile = {.i = -1, .j = -1};
 
   private:
-    void update_supergrid(int i, int j);
     void update_supergrid();
+    unsigned long long hash(unsigned long long seed) const;
 };
 
 inline bool operator==(const grid_coord &a, const grid_coord &b) { return a.m_i == b.m_i && a.m_j == b.m_j && a.i == b.i && a.j == b.j; }
+inline bool operator==(const supergrid_coord &a, const supergrid_coord &b) { return a.i == b.i && a.j == b.j; }
 
 namespace std {
 template <> struct hash<grid_coord> {
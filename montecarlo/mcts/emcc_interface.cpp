@@ -1,13 +1,73 @@
 #include "board.h"
 #include "mcts.h"
+#include "scheduler.h"
 
 //#define PROC_COUNT 2 // by default, build with multicore support
 
-MCTSTree tree;
+// Engines are addressed by handles, each with its own tree, budget and statistics, so games never share
+// a transposition table, a lock or a node budget. Destroyed handles leave a null slot that the next
+// create_engine reuses. Handle 0 always exists and backs the calls that take a board or no handle.
+// Every call holds its own reference to the engine it acts on, so an engine destroyed meanwhile is only freed once
+// the last call using it returns.
+// Multi-core builds run every background search, of every engine, as slices on the shared pool. Declared before the
+// engines so that it outlives them, since the engines still alive at exit cancel their searches on it as they are freed.
+SearchScheduler scheduler;
+
+vector<shared_ptr<MCTSTree>> engines;
+std::mutex engines_lock;
+
+// Runs on whichever thread drops the last reference: no call can submit the engine to the scheduler after that, so
+// cancelling there is final.
+void free_engine(MCTSTree *engine) {
+    if (PROC_COUNT > 1) {
+        scheduler.cancel(engine);
+    }
+    delete engine;
+}
+
+shared_ptr<MCTSTree> make_engine(int iterations, int max_nodes, bool ponder) {
+    shared_ptr<MCTSTree> engine(new MCTSTree(), free_engine);
+    engine->config.iterations = iterations > 0 ? iterations : (PROC_COUNT == 1 ? 10000 : 100000);
+    engine->config.max_nodes = max_nodes > 0 ? max_nodes : engine->config.max_nodes;
+    // Single core builds have no threads to ponder on.
+    engine->config.ponder = ponder && PROC_COUNT > 1;
+    return engine;
+}
+
+MCTSTree &tree = *engines.emplace_back(make_engine(0, 0, true));
+
+// Start a search of the root, which holds the board, that ends at the deadline, if there is one, or when the
+// engine's budget runs out.
+void start_engine_search(MCTSTree &engine, const Board &board, shared_ptr<MCTSNode> root, int time_ms) {
+    auto deadline = time_ms > 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(time_ms)
+                                : std::chrono::steady_clock::time_point::max();
+    if (PROC_COUNT > 1) {
+        scheduler.submit(&engine, board, root, deadline);
+    } else {
+        engine.start_search(board, root, false, deadline);
+    }
+}
+
+// The engine for a handle, or nullptr if there is none. Hold on to it for the whole call.
+shared_ptr<MCTSTree> engine(int handle) {
+    std::lock_guard<std::mutex> guard(engines_lock);
+    if (handle < 0 || handle >= engines.size()) {
+        return nullptr;
+    }
+    return engines[handle];
+}
+
+// Moves cross the interface packed one coordinate per byte: m_i, m_j, i, j from the high byte down.
+int pack_move(const grid_coord &move) { return (move.m_i << 24) | (move.m_j << 16) | (move.i << 8) | move.j; }
+
+grid_coord unpack_move(int move) {
+    return grid_coord{.m_i = (move >> 24) & 0xff, .m_j = (move >> 16) & 0xff, .i = (move >> 8) & 0xff, .j = move & 0xff};
+}
 
 extern "C" float get_value(char grid[9][9], int player, int i, int j) {
     supergrid_coord major_tile{i, j};
     Board board(grid, player, major_tile);
+    tree.stop_pondering();
     shared_ptr<MCTSNode> node = tree.get_node(board, nullptr);
     printf("Requested value for player %d, sgs (%d, %d) = %f\n", player, i, j, node->Q());
     return node->Q();
@@ -16,48 +76,186 @@ extern "C" float get_value(char grid[9][9], int player, int i, int j) {
 extern "C" int get_move(char grid[9][9], int player, int i, int j) {
     supergrid_coord major_tile{i, j};
     Board board(grid, player, major_tile);
-    auto node = tree.get_node(board, nullptr);
-    if (PROC_COUNT == 1) {
-        tree.mcts(board, 10000);
-    } else {
-        tree.mcts(board, 100000);
+    tree.config.iterations = PROC_COUNT == 1 ? 10000 : 100000;
+    grid_coord move = tree.choose_move(board);
+    if (tree.config.ponder) {
+        board.move(move);
+        tree.start_pondering(board);
     }
-    node->prune_ancestors();
-    node->prune_children();
-    printf("Overall transposition hitrate: %f\n", tree.transposition_hitrate());
-    printf("Total node autopurges: %lld\n", tree.purges());
-    if (tree.transposition_size() > 500000) {
-        printf("Transposition table too big, doing drastic prune!\n");
-        tree.prune(250000);
-        printf("New total node purges: %lld\n", tree.purges());
+    return pack_move(move);
+}
+
+// Start searching the position for up to the given number of iterations (10000 or 100000 when not positive)
+// and return at once. Multi-core builds search on the shared worker pool; single core builds search one slice per
+// poll_search call, so callers can spread the search over animation frames.
+extern "C" void start_search(char grid[9][9], int player, int i, int j, int iterations) {
+    supergrid_coord major_tile{i, j};
+    Board board(grid, player, major_tile);
+    tree.config.iterations = iterations > 0 ? iterations : (PROC_COUNT == 1 ? 10000 : 100000);
+    start_engine_search(tree, board, tree.get_node(board, nullptr), 0);
+}
+
+// Create an engine with its own tree and return its handle. Non-positive iterations and max_nodes take the
+// defaults; pondering only happens in multi-core builds.
+extern "C" int create_engine(int iterations, int max_nodes, int ponder) {
+    shared_ptr<MCTSTree> created = make_engine(iterations, max_nodes, ponder != 0);
+    created->verbose = false;
+    std::lock_guard<std::mutex> guard(engines_lock);
+    for (int handle = 1; handle < engines.size(); handle++) {
+        if (engines[handle] == nullptr) {
+            engines[handle] = std::move(created);
+            return handle;
+        }
     }
-    printf("Overall transposition size: %d\n", tree.transposition_size());
-    grid_coord move = node->get_move();
-    int i_move = (move.m_i << 24) | (move.m_j << 16) | (move.i << 8) | move.j;
-    return i_move;
+    engines.push_back(std::move(created));
+    return engines.size() - 1;
 }
 
+// Destroy an engine and free its tree once the calls still running on it have returned. Returns 0 for handle 0 or a
+// handle that does not exist.
+extern "C" int destroy_engine(int handle) {
+    shared_ptr<MCTSTree> destroyed;
+    {
+        std::lock_guard<std::mutex> guard(engines_lock);
+        if (handle <= 0 || handle >= engines.size() || engines[handle] == nullptr) {
+            return 0;
+        }
+        destroyed = std::move(engines[handle]);
+    }
+    // Unless a call still holds it, the tree is torn down here, outside the lock.
+    return 1;
+}
+
+// The session calls below keep the game inside the engine, so a turn costs one move instead of a whole board.
+// Each returns -1 (or a null pointer, or a finished status with no move) for an unknown handle.
+// Start a new game from the empty board.
+extern "C" int engine_new_game(int handle) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    if (found == nullptr) {
+        return -1;
+    }
+    found->new_game();
+    return 0;
+}
+
+// Play a packed move for whichever side is to move. Returns 0 if the move is illegal.
+extern "C" int engine_apply_move(int handle, int move) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    return found == nullptr ? -1 : found->apply_move(unpack_move(move));
+}
+
+// Search the current position and return the packed best move without playing it.
+// A positive iteration count replaces the engine's budget.
+extern "C" int engine_search(int handle, int iterations) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    if (found == nullptr) {
+        return -1;
+    }
+    found->config.iterations = iterations > 0 ? iterations : found->config.iterations;
+    grid_coord move = found->choose_move(found->position, found->position_root());
+    if (found->config.ponder) {
+        Board board(found->position);
+        board.move(move);
+        found->start_pondering(board);
+    }
+    return pack_move(move);
+}
+
+// Start searching the current position and return at once. A positive time_ms is the move deadline: the search
+// stops there, and in multi-core builds the shared worker pool always serves the engine closest to its deadline
+// first. Single core builds search one slice per poll_search call instead, so callers can spread the search over
+// animation frames.
+extern "C" int engine_start_search(int handle, int iterations, int time_ms) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    if (found == nullptr) {
+        return -1;
+    }
+    found->config.iterations = iterations > 0 ? iterations : found->config.iterations;
+    start_engine_search(*found, found->position, found->position_root(), time_ms);
+    return 0;
+}
+
+// Report the best move so far, its value for the player to move and the iterations run.
+extern "C" search_status engine_poll_search(int handle) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    return found == nullptr ? search_status{Board::NO_MOVE, TIE_REWARD, 0, true} : found->poll_search();
+}
+
+// Finish the search and return its final result, pondering on the reply to the chosen move if enabled.
+extern "C" search_status engine_stop_search(int handle) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    if (found == nullptr) {
+        return search_status{Board::NO_MOVE, TIE_REWARD, 0, true};
+    }
+    Board board;
+    search_status status = found->stop_search(&board);
+    if (found->config.ponder && status.move.m_i != Board::NO_MOVE.m_i) {
+        board.move(status.move);
+        found->start_pondering(board);
+    }
+    return status;
+}
+
+// The address of the engine's root statistics buffer, which every finished search refills in place.
+// It stays valid until the engine is destroyed.
+extern "C" root_stats *engine_root_stats(int handle) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    return found == nullptr ? nullptr : &found->results;
+}
+
+// Estimated bytes held by the engine's tree. Call it between searches.
+extern "C" double engine_memory_usage(int handle) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    return found == nullptr ? -1 : found->memory_usage();
+}
+
+// Compact the engine's tree after a search once less than the given fraction of its node arena is live (see
+// MCTSTree::compact), or never at 0. Engines follow whole games, so most of their tree dies as each move prunes it,
+// but compacting copies every live node while both copies are held, on the thread that stops the search. Single core
+// builds run that on the page's main thread, so they keep it off and return 0. Call it between searches.
+extern "C" int engine_set_compaction(int handle, float below) {
+    shared_ptr<MCTSTree> found = engine(handle);
+    if (found == nullptr) {
+        return -1;
+    }
+    if (PROC_COUNT == 1) {
+        return 0;
+    }
+    found->config.compact_below = below > 0 ? below : 0;
+    return 1;
+}
+
+// The calls without a handle act on engine 0.
+extern "C" void new_game() { engine_new_game(0); }
+extern "C" int apply_move(int move) { return engine_apply_move(0, move); }
+extern "C" int search(int iterations) { return engine_search(0, iterations); }
+extern "C" search_status poll_search() { return engine_poll_search(0); }
+extern "C" search_status stop_search() { return engine_stop_search(0); }
+extern "C" root_stats *get_root_stats() { return engine_root_stats(0); }
+
 extern "C" policy_vec get_policy(char grid[9][9], int player, int i, int j) {
     supergrid_coord major_tile{i, j};
     Board board(grid, player, major_tile);
+    tree.stop_pondering();
     auto node = tree.get_node(board, nullptr);
     if (PROC_COUNT == 1) {
-        tree.mcts(board, 50000);
+        tree.mcts(board, node, 50000);
     } else {
-        tree.mcts(board, 100000);
+        tree.mcts(board, node, 100000);
     }
-    auto policy = node->get_policy();
+    policy_vec policy;
+    node->get_policy(&policy.policy[0][0]);
     return policy;
 }
 
-extern "C" long long transposition_table_size() { return tree.transposition_table.size(); }
+extern "C" long long transposition_table_size() { return tree.transposition_size(); }
 
 int test_main() {
     Board board;
     MCTSTree supertree;
     shared_ptr<MCTSNode> node = supertree.get_node(board, nullptr);
     supertree.mcts(board, 50000);
-    printf("%u/%u\n", node->wins, node->visits);
+    printf("%f/%u\n", (float)node->reward, node->visits.load());
     grid_coord move = node->get_move();
     printf("%d, %d, %d, %d\n", move.m_i, move.m_j, move.i, move.j);
     return 0;
@@ -0,0 +1,68 @@
+#include "epoch.h"
+#include <thread>
+
+// The slot this thread claimed last, where enter looks first.
+thread_local int slot_hint = 0;
+
+// Claim a free slot and pin the current epoch in it, waiting for a slot if all of them are taken.
+// Returns the slot to hand to leave.
+int EpochReclaimer::enter() {
+    while (true) {
+        for (int k = 0; k < MAX_READERS; k++) {
+            int slot = (slot_hint + k) % MAX_READERS;
+            unsigned long long free = 0;
+            if (readers[slot].epoch.load(std::memory_order_relaxed) == 0 &&
+                readers[slot].epoch.compare_exchange_strong(free, epoch.load())) {
+                slot_hint = slot;
+                return slot;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+// Hold on to a reference that has just been unlinked until no reader can still reach it.
+void EpochReclaimer::retire(std::shared_ptr<void> garbage) {
+    std::lock_guard<std::mutex> guard(lock);
+    retired.emplace_back(epoch.load(), std::move(garbage));
+}
+
+// Advance the epoch and release every retired reference that is older than every pinned reader.
+// The references are dropped after the lock is let go, so whatever they free may retire more.
+void EpochReclaimer::collect() {
+    std::vector<std::shared_ptr<void>> released;
+    lock.lock();
+    unsigned long long oldest = ++epoch;
+    for (reader_slot &reader : readers) {
+        unsigned long long pinned = reader.epoch;
+        if (pinned != 0 && pinned < oldest) {
+            oldest = pinned;
+        }
+    }
+    std::vector<std::pair<unsigned long long, std::shared_ptr<void>>> kept;
+    for (auto &entry : retired) {
+        if (entry.first < oldest) {
+            released.push_back(std::move(entry.second));
+        } else {
+            kept.push_back(std::move(entry));
+        }
+    }
+    retired.swap(kept);
+    lock.unlock();
+}
+
+// Wait until every reader pinned at the time of the call has let go, then collect, which releases everything
+// retired before the call. Must not be called while pinned.
+void EpochReclaimer::synchronize() {
+    unsigned long long now = ++epoch;
+    for (reader_slot &reader : readers) {
+        while (true) {
+            unsigned long long pinned = reader.epoch;
+            if (pinned == 0 || pinned >= now) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+    collect();
+}
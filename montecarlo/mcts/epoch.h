@@ -0,0 +1,43 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+typedef struct _reader_slot {
+    alignas(64) std::atomic<unsigned long long> epoch{0}; // The epoch its reader pinned, or 0 when free.
+} reader_slot;
+
+// Epoch based reclamation, for structures that readers walk through plain pointers while writers unlink parts of
+// them. A reader pins the current epoch for as long as it holds such pointers (see EpochGuard). A writer hands the
+// references it unlinks to retire instead of dropping them, and they are only released once every reader that was
+// pinned when they were retired has let go.
+class EpochReclaimer {
+  public:
+    static const int MAX_READERS = 256;
+    int enter();
+    void leave(int slot) { readers[slot].epoch = 0; }
+    void retire(std::shared_ptr<void> garbage);
+    void collect();
+    void synchronize();
+
+  private:
+    std::atomic<unsigned long long> epoch{1};
+    reader_slot readers[MAX_READERS];
+    std::mutex lock;
+    std::vector<std::pair<unsigned long long, std::shared_ptr<void>>> retired; // With the epoch they were retired in.
+};
+
+// Pins the reclaimer's current epoch while in scope.
+class EpochGuard {
+  public:
+    EpochGuard(EpochReclaimer &reclaimer) : reclaimer(reclaimer), slot(reclaimer.enter()) {}
+    ~EpochGuard() { reclaimer.leave(slot); }
+
+  private:
+    EpochReclaimer &reclaimer;
+    int slot;
+};
+
+#endif
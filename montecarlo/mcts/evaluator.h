@@ -0,0 +1,26 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+#include "board.h"
+
+// A static position evaluator that can stand in for, or be mixed with, random rollouts.
+// Implementations are shared between search threads, so evaluate() must not mutate shared state.
+template <typename Game> class GameEvaluator {
+  public:
+    virtual ~GameEvaluator() {}
+    // Return the expected reward in [0, 1] for the player to move.
+    // Evaluators with priors also write one unnormalized log-probability per move slot (see Game::move_index),
+    // which for Board is one per cell, indexed 9 * row + column.
+    virtual float evaluate(const Game &board, float policy_logits[Game::MAX_MOVES]) = 0;
+    virtual bool has_priors() const { return false; }
+    // Evaluate count boards at once, writing one value per board and MAX_MOVES logits per board.
+    // Evaluators that amortize work across a batch override this; the default evaluates one board at a time.
+    virtual void evaluate_batch(const Game *const *boards, int count, float *values, float *policy_logits) {
+        for (int n = 0; n < count; n++) {
+            values[n] = evaluate(*boards[n], policy_logits + Game::MAX_MOVES * n);
+        }
+    }
+};
+
+typedef GameEvaluator<Board> Evaluator;
+
+#endif
@@ -1,139 +1,347 @@
 #include "mcts.h"
+#include "policies.h"
+#include "tictactoe.h"
 
-const float C = 1.44;
-const float TIE_REWARD = 0.5;
 const float inf = std::numeric_limits<float>::infinity();
+// Iterations run between checks of the clock and of requests to stop.
+const int SEARCH_SLICE = 256;
+// Iterations per task of a parallel search.
+const int PARALLEL_CHUNK = 16;
+// Iterations per task of pondering.
+const int PONDER_SLICE = 64;
 
 // Given a board and a parent, returns the node for the board and parent.
 // If the board state already exists in the transposition table, this will add the parent to the node.
 // If it does not, it will allocate a new node and parent.
 // The returned node will be bound to the lifetime of its parent.
-shared_ptr<MCTSNode> MCTSTree::get_node(const Board &new_board, shared_ptr<MCTSNode> new_parent) {
+template <typename Game>
+shared_ptr<GameNode<Game>> GameTree<Game>::get_node(const Game &new_board, shared_ptr<GameNode<Game>> new_parent) {
+    return get_node(new_board, new_parent, transposition_table.hash(position_key(new_board)));
+}
+
+// The same, for callers that already hashed the board's key with transposition_table.hash.
+template <typename Game>
+shared_ptr<GameNode<Game>> GameTree<Game>::get_node(const Game &new_board, shared_ptr<GameNode<Game>> new_parent,
+                                                    size_t hash) {
     tree_lock.lock();
     total_lookups++;
-    if (transposition_table.find(new_board) != transposition_table.end()) {
-        auto wk_node = transposition_table[new_board];
-        if (wk_node.expired()) {
-            transposition_table.erase(transposition_table.find(new_board));
+    const table_key<Game> &key = position_key(new_board);
+    unsigned slot = transposition_table.find(key, hash);
+    shared_ptr<GameNode<Game>> found;
+    if (slot != NO_SLOT) {
+        // Lock before checking: a node released by another thread can expire at any moment.
+        found = transposition_table[slot].lock();
+        if (found == nullptr && verbose) {
             printf("Found dead node in get_node!\n");
-            return get_node(new_board, new_parent);
         }
-        shared_ptr<MCTSNode> node = wk_node.lock();
-        if (node->parents.size() == 0 && new_parent != nullptr) {
-            printf("Unrooting!\n");
-            auto itr = find(roots.begin(), roots.end(), node);
-            roots.erase(itr);
+    }
+    // Lean nodes can share a key with a different position, which then gets a node without a table entry.
+    if (found != nullptr && found->holds(new_board)) {
+        std::lock_guard<SpinLock> parents_guard(found->parents_lock);
+        found->parents.remove_expired();
+        if (found->parents.size() == 0 && new_parent != nullptr) {
+            // Nodes orphaned by pruning have no parents either, but were never roots.
+            auto itr = find(roots.begin(), roots.end(), found);
+            if (itr != roots.end()) {
+                if (verbose) {
+                    printf("Unrooting!\n");
+                }
+                roots.erase(itr);
+            }
         }
         if (new_parent != nullptr) {
-            node->parents.push_back(new_parent);
+            found->parents.push_back(new_parent);
         }
-        tree_lock.unlock();
         total_hits++;
-        return node;
+        tree_lock.unlock();
+        return found;
+    }
+    shared_ptr<GameNode<Game>> node =
+        config.compact_below > 0
+            ? std::allocate_shared<GameNode<Game>>(arena_allocator<GameNode<Game>>(arena), new_board, new_parent, this)
+            : make_shared<GameNode<Game>>(new_board, new_parent, this);
+    if (slot == NO_SLOT) {
+        node->table_slot = transposition_table.insert(key, hash, node);
+    } else if (found == nullptr) {
+        // Take over the dead node's entry. Its destructor leaves an entry it no longer owns alone.
+        transposition_table[slot] = node;
+        node->table_slot = slot;
     }
-    shared_ptr<MCTSNode> node = make_shared<MCTSNode>(new_board, new_parent, this);
-    auto entry = pair<Board, weak_ptr<MCTSNode>>(new_board, node);
-    transposition_table.insert(entry);
     if (new_parent == nullptr) {
-        printf("Rooting node!\n");
+        if (verbose) {
+            printf("Rooting node!\n");
+        }
         roots.push_back(node);
     }
     tree_lock.unlock();
     return node;
 }
 
+// Start loading the transposition table entries for the hashes, so that the get_node calls that follow find them in
+// cache. No bucket read waits on another, so their misses overlap instead of coming one per get_node.
+template <typename Game> void GameTree<Game>::prefetch_nodes(const size_t *hashes, int count) {
+    tree_lock.lock();
+    for (int i = 0; i < count; i++) {
+        const void *entry = transposition_table.bucket_head(hashes[i]);
+        if (entry != nullptr) {
+            prefetch(entry);
+        }
+    }
+    tree_lock.unlock();
+}
+
 // Commit filicide on all but the most explored child nodes.
 // The idea is that we no longer need all of the subtrees from this node,
 // only the most common one and the information to seek it out.
-// See MCTSNode::filicide to understand how filicide works.
-void MCTSTree::prune(unsigned max_size) {
+// See GameNode::filicide to understand how filicide works.
+// The exception is the way down to keep, the root being searched: above it, only the children that lead to it survive,
+// however few visits they have, so its subtree is always pruned last. With keep_subtree set, as while keep is still
+// being searched, nothing at or below keep is pruned at all, even where another parent reaches it.
+// Searches may keep running meanwhile. What they might still be walking through is only freed once they have moved
+// on, so after each level of the tree this waits for them before counting the table again. Returns at once if
+// another thread is already pruning.
+template <typename Game>
+void GameTree<Game>::prune(unsigned max_size, shared_ptr<GameNode<Game>> keep, bool keep_subtree) {
+    std::unique_lock<std::mutex> pruning(prune_lock, std::try_to_lock);
+    if (!pruning.owns_lock()) {
+        return;
+    }
+    // Collect keep and its ancestors, holding them so none of them can be freed and its address reused meanwhile.
+    vector<shared_ptr<GameNode<Game>>> kept{keep};
+    std::unordered_set<GameNode<Game> *> on_path{keep.get()};
+    for (int k = 0; k < kept.size(); k++) {
+        std::lock_guard<SpinLock> parents_guard(kept[k]->parents_lock);
+        for (int i = 0; i < kept[k]->parents.size(); i++) {
+            shared_ptr<GameNode<Game>> parent = kept[k]->parents[i].lock();
+            if (parent != nullptr && on_path.insert(parent.get()).second) {
+                kept.push_back(parent);
+            }
+        }
+    }
+    std::unordered_set<GameNode<Game> *> below;
+    if (keep_subtree) {
+        vector<shared_ptr<GameNode<Game>>> stack{keep};
+        below.insert(keep.get());
+        while (!stack.empty()) {
+            shared_ptr<GameNode<Game>> node = stack.back();
+            stack.pop_back();
+            node->lock.lock();
+            vector<shared_ptr<GameNode<Game>>> children = node->children;
+            node->lock.unlock();
+            for (const shared_ptr<GameNode<Game>> &child : children) {
+                if (below.insert(child.get()).second) {
+                    stack.push_back(child);
+                }
+            }
+        }
+    }
     tree_lock.lock();
-    queue<shared_ptr<MCTSNode>> inspection_queue;
-    for (shared_ptr<MCTSNode> root : roots) {
-        inspection_queue.push(root);
-    }
-    while (transposition_table.size() > max_size) {
-        shared_ptr<MCTSNode> node = inspection_queue.front();
-        inspection_queue.pop();
-        unsigned max_visits = 0;
-        for (auto child : node->children) {
-            max_visits = max_visits > node->visits ? max_visits : node->visits;
-        }
-        for (auto child : node->children) {
-            if (child->visits <= max_visits) {
-                child->filicide();
+    vector<shared_ptr<GameNode<Game>>> level = roots;
+    tree_lock.unlock();
+    while (transposition_size() > max_size && !level.empty()) {
+        vector<shared_ptr<GameNode<Game>>> next_level;
+        for (int i = 0; i < level.size() && transposition_size() > max_size; i++) {
+            level[i]->lock.lock();
+            vector<shared_ptr<GameNode<Game>>> children = level[i]->children;
+            level[i]->lock.unlock();
+            unsigned max_visits = 0;
+            bool leads_to_keep = false;
+            for (auto child : children) {
+                max_visits = std::max(max_visits, child->visits.load());
+                leads_to_keep |= on_path.count(child.get()) > 0;
+            }
+            for (auto child : children) {
+                if (below.count(child.get()) > 0) {
+                    continue;
+                }
+                if (leads_to_keep ? on_path.count(child.get()) == 0 : child->visits < max_visits) {
+                    child->filicide();
+                } else {
+                    next_level.push_back(child);
+                }
             }
+            reclaimer.collect();
+        }
+        reclaimer.synchronize();
+        level.swap(next_level);
+    }
+}
+
+// Copy every node reachable from the roots into a fresh arena and let the old one go, which frees it in one step
+// once its last node dies. Each node's children are copied side by side, and then each of their subtrees in turn,
+// depth first, so selection scans one contiguous block per level and mostly descends to nearby memory.
+// The transposition table, roots and position are moved over to the copies. Nodes held outside the tree keep the
+// old versions of themselves and their subtrees. Must not run alongside a search or pondering.
+template <typename Game> void GameTree<Game>::compact() {
+    tree_lock.lock();
+    long long purged = total_fillicides;
+    arena_allocator<GameNode<Game>> allocator(make_shared<NodeArena>());
+    unordered_map<GameNode<Game> *, shared_ptr<GameNode<Game>>> copies;
+    auto copy = [&](const shared_ptr<GameNode<Game>> &node) {
+        shared_ptr<GameNode<Game>> &copied = copies[node.get()];
+        if (copied == nullptr) {
+            copied = std::allocate_shared<GameNode<Game>>(allocator, *node);
+        }
+        return copied;
+    };
+    vector<shared_ptr<GameNode<Game>>> old_roots;
+    old_roots.swap(roots);
+    vector<shared_ptr<GameNode<Game>>> stack;
+    for (auto it = old_roots.rbegin(); it != old_roots.rend(); it++) {
+        copy(*it);
+        stack.push_back(*it);
+    }
+    for (auto it = old_roots.begin(); it != old_roots.end(); it++) {
+        roots.push_back(copies[it->get()]);
+    }
+    while (!stack.empty()) {
+        shared_ptr<GameNode<Game>> node = stack.back();
+        stack.pop_back();
+        shared_ptr<GameNode<Game>> copied = copies[node.get()];
+        // A transposition is reached once per parent, but only linked the first time.
+        if (copied->children.size() == node->children.size()) {
+            continue;
         }
+        for (const shared_ptr<GameNode<Game>> &child : node->children) {
+            shared_ptr<GameNode<Game>> copied_child = copy(child);
+            copied->children.push_back(copied_child);
+            copied_child->parents.push_back(copied);
+        }
+        for (auto it = node->children.rbegin(); it != node->children.rend(); it++) {
+            stack.push_back(*it);
+        }
+    }
+    transposition_table.for_each([&](unsigned slot, weak_ptr<GameNode<Game>> &entry) {
+        auto found = copies.find(entry.lock().get());
+        if (found != copies.end()) {
+            entry = found->second;
+            found->second->table_slot = slot;
+        }
+    });
+    if (position_node != nullptr && copies.count(position_node.get())) {
+        position_node = copies[position_node.get()];
     }
+    arena = allocator.arena;
+    copies.clear();
+    old_roots.clear();
+    total_fillicides = purged;
     tree_lock.unlock();
 }
 
 // Get the percentage of get_node that falls into the transposition table.
-float MCTSTree::transposition_hitrate() { return total_hits / ((float)total_lookups); }
+template <typename Game> float GameTree<Game>::transposition_hitrate() { return total_hits / ((float)total_lookups); }
 
 // Get the number of nodes in the transposition table
-int MCTSTree::transposition_size() { return transposition_table.size(); }
+template <typename Game> int GameTree<Game>::transposition_size() {
+    std::lock_guard<recursive_mutex> guard(tree_lock);
+    return transposition_table.size();
+}
 
 // Get the total number of times filicide() has been invoked
-long long MCTSTree::purges() { return total_fillicides; }
+template <typename Game> long long GameTree<Game>::purges() { return total_fillicides; }
+
+// Estimate the bytes held by the tree: nodes, their edge vectors and the transposition table entries.
+template <typename Game> size_t GameTree<Game>::memory_usage() {
+    tree_lock.lock();
+    size_t bytes = transposition_table.memory_usage();
+    transposition_table.for_each([&](unsigned slot, weak_ptr<GameNode<Game>> &entry) {
+        shared_ptr<GameNode<Game>> node = entry.lock();
+        if (node == nullptr) {
+            return;
+        }
+        bytes += sizeof(GameNode<Game>) + 2 * sizeof(long);
+        bytes += node->children.capacity() * sizeof(shared_ptr<GameNode<Game>>);
+        bytes += node->parents.heap_bytes();
+        bytes += node->moves.capacity() * sizeof(typename Game::move_type);
+    });
+    tree_lock.unlock();
+    return bytes;
+}
+
+// Release the nodes before the transposition table they erase themselves from.
+template <typename Game> GameTree<Game>::~GameTree() {
+    stop_pondering();
+    searching = false;
+    search_lock.lock();
+    search_lock.unlock();
+    roots.clear();
+    reclaimer.collect();
+}
 
 // Construct a new MCTSNode - don't use this.
-MCTSNode::MCTSNode(const Board &new_board, shared_ptr<MCTSNode> new_parent, MCTSTree *host) {
+template <typename Game>
+GameNode<Game>::GameNode(const Game &new_board, shared_ptr<GameNode<Game>> new_parent, GameTree<Game> *host) {
+#ifdef MCTS_LEAN_NODES
+    hash = new_board.key();
+    check = new_board.check();
+#else
     board = new_board;
+#endif
+    player = new_board.player;
     tree = host;
     parents.push_back(new_parent);
-    moves = board.get_valid_moves();
 }
 
-// Get the node's expected value (Q-score).
-// This is calculated taking ties into account,
-// and relies on the current 
-float MCTSNode::Q() {
-    lock.lock(); //
-    float sum = wins + TIE_REWARD * ties;
-    float res = sum / (1.0f + visits);
-    lock.unlock();
-    return res;
+// Copy another node's position and statistics, but none of its edges (see GameTree::compact).
+template <typename Game> GameNode<Game>::GameNode(const GameNode<Game> &other) {
+#ifdef MCTS_LEAN_NODES
+    hash = other.hash;
+    check = other.check;
+#else
+    board = other.board;
+#endif
+    moves = other.moves;
+    visits = other.visits.load();
+    reward = other.reward;
+    reward_sq = other.reward_sq;
+    virtual_loss = other.virtual_loss;
+    value = other.value;
+    expanded = other.expanded.load();
+    player = other.player;
+    tree = other.tree;
+    children.reserve(other.children.size());
+    if (other.priors != nullptr) {
+        priors.reset(new float[moves.size()]);
+        std::copy(other.priors.get(), other.priors.get() + moves.size(), priors.get());
+    }
 }
 
+// Get the node's expected value (Q-score).
+// Ties are folded into the reward by the search's reward type when they are backpropagated.
+// Pending evaluations count as wins for this node's player, which steers the parent's player away from it.
+template <typename Game> float GameNode<Game>::Q() { return (reward + virtual_loss) / (1.0f + visits); }
+
 // Get the parent node's Q-score
-float MCTSNode::parent_Q() {
-    unsigned losses = visits - wins - ties;
-    float loss = losses / (1.0f + visits);
-    float tie = TIE_REWARD * ties / (1.0f + visits);
-    return loss + tie;
-}
+template <typename Game> float GameNode<Game>::parent_Q() { return (visits - reward) / (1.0f + visits); }
 
-float MCTSNode::U() {
-    unsigned parent_visit_count = 0;
-    for (int i = 0; i < parents.size(); i++) {
-        auto parent = parents[i];
-        if (parent.expired()) {
-            parents.erase(parents.begin() + i);
-            i--;
-            continue;
-        }
-        parent_visit_count += parent.lock()->visits;
-    }
-    return C * sqrt((float)parent_visit_count) / (1.0 + visits);
+// The exploration bonus of the default PUCT policy without priors, as seen from a parent with parent_visits visits.
+template <typename Game> float GameNode<Game>::U(unsigned parent_visits) {
+    return tree->config.c * sqrt((float)parent_visits) / (1.0 + visits);
 }
 
-float MCTSNode::PUCT() { return Q() + U(); }
+template <typename Game> float GameNode<Game>::PUCT(unsigned parent_visits) { return Q() + U(parent_visits); }
 
-grid_coord MCTSNode::get_move() const {
+// Pick the child with the lowest Q, breaking ties by visits. With enumerate set, verbose trees print every child.
+template <typename Game> typename GameNode<Game>::move_type GameNode<Game>::get_move(bool enumerate) const {
     float best_Q = inf;
     int best_visits = 0;
-    grid_coord best_move = {-1, -1, -1, -1};
+    move_type best_move = Game::NO_MOVE;
+    lock.lock();
     if (!expanded) {
+        lock.unlock();
         return best_move;
     }
-    lock.lock();
-    printf("--- Move enumeration ---\n");
+    enumerate = enumerate && tree->verbose;
+    if (enumerate) {
+        printf("--- Move enumeration ---\n");
+    }
     for (int i = 0; i < children.size(); i++) {
-        shared_ptr<MCTSNode> child = children[i];
+        shared_ptr<GameNode<Game>> child = children[i];
         float Q = child->Q();
-        printf("N(%d, %d, %d, %d)/%d - valued by %d as %f \n ", moves[i].m_i, moves[i].m_j, moves[i].i, moves[i].j,
-               child->visits, child->board.player, Q);
+        if (enumerate) {
+            printf("N(%d)/%u - valued by %d as %f \n ", Game::move_index(moves[i]), child->visits.load(),
+                   child->player, Q);
+        }
         if (Q < best_Q) {
             best_Q = Q;
             best_visits = child->visits;
@@ -144,61 +352,120 @@ grid_coord MCTSNode::get_move() const {
             best_move = moves[i];
         }
     }
-    printf("----\n");
+    if (enumerate) {
+        printf("----\n");
+    }
     lock.unlock();
     return best_move;
 }
 
-policy_vec MCTSNode::get_policy() const {
-    policy_vec vec;
+// The child reached by the move, or nullptr if this node has not been expanded.
+template <typename Game> shared_ptr<GameNode<Game>> GameNode<Game>::child(const move_type &move) const {
+    shared_ptr<GameNode<Game>> found = nullptr;
+    lock.lock();
+    for (int i = 0; i < children.size(); i++) {
+        if (moves[i] == move) {
+            found = children[i];
+            break;
+        }
+    }
+    lock.unlock();
+    return found;
+}
+
+// Write the value of every legal move for this node's player by Game::move_index, and zero everywhere else.
+template <typename Game> void GameNode<Game>::get_policy(float policy[Game::MAX_MOVES]) const {
+    std::fill(policy, policy + Game::MAX_MOVES, 0.0f);
     if (!expanded) {
-        return vec;
+        return;
     }
     lock.lock();
     for (int ind = 0; ind < children.size(); ind++) {
-        shared_ptr<MCTSNode> child = children[ind];
-        int i = moves[ind].m_i * 3 + moves[ind].i;
-        int j = moves[ind].m_i * 3 + moves[ind].i;
-        vec.policy[i][j] = 1 - child->Q() + 0.00001;
+        shared_ptr<GameNode<Game>> child = children[ind];
+        policy[Game::move_index(moves[ind])] = 1 - child->Q() + 0.00001;
     }
     lock.unlock();
-    return vec;
 }
 
-shared_ptr<MCTSNode> MCTSNode::max_PUCT() {
-    float best_PUCT = -inf;
-    shared_ptr<MCTSNode> best_node = nullptr;
+// The child the policy scores highest for this node's player, and the move that leads to it.
+template <typename Game>
+template <typename Policy>
+GameNode<Game> *GameNode<Game>::select_child(move_type &move) {
+    float best_score = -inf;
+    GameNode<Game> *best_node = nullptr;
+    float c = tree->config.c;
+    float parent_visits = visits;
     lock.lock();
-    for (shared_ptr<MCTSNode> child : children) {
-        float PUCT = (1 - child->Q()) + child->U();
-        if (PUCT > best_PUCT) {
-            best_PUCT = PUCT;
+    // Request every child's statistics up front, so their misses overlap rather than stall the scoring loop one
+    // child at a time.
+    for (const shared_ptr<GameNode<Game>> &child : children) {
+        prefetch(&child->visits);
+    }
+    // The statistics are read without the children's locks, so a child being backpropagated meanwhile may be scored
+    // on a mix of its old and new values, which only nudges one selection.
+    for (int i = 0; i < children.size(); i++) {
+        GameNode<Game> *child = children[i].get();
+        child_stats stats;
+        float n = child->visits.load(std::memory_order_relaxed);
+        float reward = child->reward;
+        stats.mean = 1 - (reward + child->virtual_loss) / (1 + n);
+        stats.mean_sq = (n - 2 * reward + child->reward_sq) / (1 + n);
+        stats.prior = priors == nullptr ? 1.0f : priors[i];
+        stats.visits = n;
+        stats.parent_visits = parent_visits;
+        float score = Policy::score(stats, c);
+        if (score > best_score) {
+            best_score = score;
             best_node = child;
+            move = moves[i];
         }
     }
     lock.unlock();
+    // Selection descends into the winner next. Its statistics are already in cache from scoring it, but the line
+    // holding its tree pointer, the children and moves vector headers and the priors pointer is not, so request that
+    // while the caller plays the move. The arrays those point to can only be read under its lock once that line is in.
+    if (best_node != nullptr) {
+        prefetch(&best_node->tree);
+    }
     return best_node;
 }
 
-vector<shared_ptr<MCTSNode>> MCTSNode::select() {
-    vector<shared_ptr<MCTSNode>> path;
-    path.reserve(64);
-    shared_ptr<MCTSNode> cur_node = shared_from_this();
+// Descend from this node, whose position board holds, to a leaf, replacing the contents of path with the nodes
+// passed through. board is left holding the leaf's position.
+// The path holds plain pointers, so descending costs no reference counting. The caller must hold this node and
+// keep the tree's epoch pinned (see EpochGuard) for as long as it uses the path: pruning may drop any node below
+// this one meanwhile, but only frees it once the pin is gone.
+template <typename Game>
+template <typename Policy>
+void GameNode<Game>::select(Game &board, vector<GameNode<Game> *> &path) {
+    path.clear();
+    GameNode<Game> *cur_node = this;
+    move_type move;
     while (cur_node->expanded) {
+        GameNode<Game> *new_node = cur_node->template select_child<Policy>(move);
+        if (new_node == nullptr) {
+            break; // Pruned since it read as expanded, so it is a leaf again.
+        }
         path.push_back(cur_node);
-        shared_ptr<MCTSNode> new_node = cur_node->max_PUCT();
-        cur_node->lock.lock();
-        cur_node->visits++;
-        cur_node->lock.unlock();
+        board.move(move);
+        cur_node->visits.fetch_add(1, std::memory_order_relaxed);
         cur_node = new_node;
     };
     path.push_back(cur_node);
-    cur_node->visits++;
-    return path;
+    cur_node->visits.fetch_add(1, std::memory_order_relaxed);
 }
 
-void MCTSNode::prune_ancestors() { prune_ancestors(shared_from_this()); }
-void MCTSNode::prune_children() {
+// Mark (or with a negative amount, unmark) every node on the path as having a pending evaluation.
+template <typename Game> void GameNode<Game>::add_virtual_loss(const vector<GameNode<Game> *> &path, int amount) {
+    for (GameNode<Game> *node : path) {
+        node->lock.lock();
+        node->virtual_loss += amount;
+        node->lock.unlock();
+    }
+}
+
+template <typename Game> void GameNode<Game>::prune_ancestors() { prune_ancestors(this->shared_from_this()); }
+template <typename Game> void GameNode<Game>::prune_children() {
     lock.lock();
     vector<float> Qs;
     for (auto child : children) {
@@ -206,7 +473,7 @@ void MCTSNode::prune_children() {
     }
     for (int i = 0; i < children.size(); i++) {
         auto child = children[i];
-        float QU = child->Q() + child->U();
+        float QU = child->PUCT(visits);
         bool prunable = false;
         for (int j = 0; j < i; j++) {
             if (QU < Qs[j]) {
@@ -225,21 +492,24 @@ void MCTSNode::prune_children() {
     lock.unlock();
 }
 
-void MCTSNode::filicide() {
+// Drop the children, leaving this node a leaf. Searches may still be walking through them, so they are retired to the
+// tree's reclaimer rather than released here.
+template <typename Game> void GameNode<Game>::filicide() {
     lock.lock();
     if (!expanded) {
         lock.unlock();
         return;
     }
+    tree->reclaimer.retire(make_shared<vector<shared_ptr<GameNode<Game>>>>(std::move(children)));
     children.clear();
     expanded = false;
     lock.unlock();
 }
 
-void MCTSNode::prune_ancestors(shared_ptr<MCTSNode> node_to_keep) {
+template <typename Game> void GameNode<Game>::prune_ancestors(shared_ptr<GameNode<Game>> node_to_keep) {
     lock.lock();
-    if (shared_from_this() != node_to_keep) {
-        for (shared_ptr<MCTSNode> child : children) {
+    if (this->shared_from_this() != node_to_keep) {
+        for (shared_ptr<GameNode<Game>> child : children) {
             if (child == node_to_keep) {
                 continue;
             }
@@ -247,90 +517,617 @@ void MCTSNode::prune_ancestors(shared_ptr<MCTSNode> node_to_keep) {
         }
     }
     lock.unlock();
+    vector<shared_ptr<GameNode<Game>>> live_parents;
+    parents_lock.lock();
+    parents.remove_expired();
     for (int i = 0; i < parents.size(); i++) {
-        auto wk_parent = parents[i];
-        if (wk_parent.expired()) {
-            parents.erase(parents.begin() + i);
-            i--;
-            continue;
+        // A parent can still die between the two steps, so lock it rather than trusting remove_expired.
+        shared_ptr<GameNode<Game>> parent = parents[i].lock();
+        if (parent != nullptr) {
+            live_parents.push_back(parent);
         }
-        shared_ptr<MCTSNode> parent = wk_parent.lock();
-        parent->prune_ancestors(shared_from_this());
+    }
+    parents_lock.unlock();
+    for (auto parent : live_parents) {
+        parent->prune_ancestors(this->shared_from_this());
     }
 }
 
-void MCTSNode::expand() {
+// Fill in the legal moves of board, this node's position, unless that was done before. Takes the lock.
+template <typename Game> void GameNode<Game>::list_moves(const Game &board) {
+    lock.lock();
+    if (moves.empty()) {
+        move_type legal[Game::MAX_MOVES];
+        moves.assign(legal, legal + board.get_valid_moves(legal));
+    }
+    lock.unlock();
+}
+
+// Create the children of board, this node's position. The node only reads as expanded once all of them exist,
+// so select never descends into a half-built node from another thread.
+template <typename Game> void GameNode<Game>::expand(const Game &board) {
     lock.lock();
     visits++;
     if (expanded) {
         lock.unlock();
         return;
     }
-    for (grid_coord move : moves) {
-        expanded = true;
-        Board new_board(board);
-        new_board.move(move);
-        shared_ptr<MCTSNode> new_node = tree->get_node(new_board, shared_from_this());
-        children.push_back(new_node);
+    list_moves(board);
+    Game new_boards[Game::MAX_MOVES];
+    size_t hashes[Game::MAX_MOVES];
+    for (int i = 0; i < moves.size(); i++) {
+        new_boards[i] = board;
+        new_boards[i].move(moves[i]);
+        hashes[i] = tree->transposition_table.hash(position_key(new_boards[i]));
+    }
+    tree->prefetch_nodes(hashes, moves.size());
+    for (int i = 0; i < moves.size(); i++) {
+        children.push_back(tree->get_node(new_boards[i], this->shared_from_this(), hashes[i]));
+    }
+    expanded = !children.empty();
+    lock.unlock();
+}
+
+// Store the softmax of the evaluator's logits over the legal moves of board, this node's position.
+// A node evaluated twice keeps its array, which selection may already be reading.
+template <typename Game> void GameNode<Game>::set_priors(const Game &board, const float *policy_logits) {
+    lock.lock();
+    list_moves(board);
+    if (priors == nullptr) {
+        priors.reset(new float[moves.size()]);
+    }
+    float max_logit = -inf;
+    for (const move_type &move : moves) {
+        max_logit = std::max(max_logit, policy_logits[Game::move_index(move)]);
+    }
+    float total = 0;
+    for (int i = 0; i < moves.size(); i++) {
+        const move_type &move = moves[i];
+        priors[i] = std::exp(policy_logits[Game::move_index(move)] - max_logit);
+        total += priors[i];
+    }
+    for (int i = 0; i < moves.size(); i++) {
+        priors[i] /= total;
     }
     lock.unlock();
 }
 
-void MCTSNode::backpropagate(const Board &board, vector<shared_ptr<MCTSNode>> path) {
-    int winner = board.game_winner();
-    for (shared_ptr<MCTSNode> &node : path) {
+// Credit every node on the path with the value, which is the expected reward for player.
+// The game is zero-sum, so everyone else is credited with 1 - value.
+// With BACKUP_GRAPH only the leaf is credited, and every node above it instead recomputes its value from its
+// children, bottom up (see refresh_value). A transposition's value covers what was learnt through all of its
+// parents, so the parents that did not lie on this path pick that up too when they are next refreshed.
+// reward_sq follows reward in both modes, so the two always describe the same visits.
+template <typename Game>
+void GameNode<Game>::backpropagate(float value, char player, const vector<GameNode<Game> *> &path) {
+    bool graph = path[0]->tree->config.backup == BACKUP_GRAPH;
+    for (int i = path.size() - 1; i >= 0; i--) {
+        GameNode<Game> *node = path[i];
         node->lock.lock();
-        if (winner == node->board.player) {
-            node->wins += 1;
-        } else if (winner == PLAYER_TIE) {
-            node->ties += 1;
+        float credit = node->player == player ? value : 1 - value;
+        if (!graph) {
+            node->reward += credit;
+            node->reward_sq += credit * credit;
+        } else if (i == path.size() - 1) {
+            node->reward += credit;
+            node->reward_sq += credit * credit;
+            node->value = node->reward / node->visits;
+        } else {
+            node->refresh_value();
         }
         node->lock.unlock();
     }
 }
 
-Board simulate(const Board &board) {
-    Board new_board(board);
-    while (new_board.game_winner() == PLAYER_NONE) {
-        vector<grid_coord> s_moves = new_board.get_valid_moves();
-        int rnum = rand() % (int)s_moves.size();
-        grid_coord move = s_moves[rnum];
+// Set the value to the mean of the children's values from this node's player's point of view, weighting each child
+// by its visits from every parent (UCT3 style). A node none of whose children has been visited keeps the value of
+// its own evaluations. Visits are kept as they are and the reward rescaled to match, so Q reads the new value.
+// The mean squared reward is mixed from the children the same way, (1 - x)^2 = 1 - 2x + x^2 for each child's x,
+// and rescaled alike, so UCB1-Tuned's variance estimate stays that of the value Q reads.
+template <typename Game> void GameNode<Game>::refresh_value() {
+    lock.lock();
+    float total = 0;
+    float total_sq = 0;
+    float weight = 0;
+    for (const shared_ptr<GameNode<Game>> &child : children) {
+        child->lock.lock();
+        unsigned n = child->visits;
+        if (n > 0) {
+            total += n * (1 - child->value);
+            // A leaf's value can be older than its visits (expand counts one it credits nothing for), so take its
+            // mean square over the same evaluations as the value.
+            float mean_sq = child->reward > 0 ? child->reward_sq / child->reward * child->value : 0;
+            total_sq += n * (1 - 2 * child->value + mean_sq);
+            weight += n;
+        }
+        child->lock.unlock();
+    }
+    if (weight > 0) {
+        value = total / weight;
+        reward = value * visits;
+        reward_sq = total_sq / weight * visits;
+    }
+    lock.unlock();
+}
+
+// Each search thread gets its own generator so rollouts never contend on rand().
+std::mt19937 &rollout_rng() {
+    thread_local std::mt19937 rng(std::random_device{}());
+    return rng;
+}
+
+// Games without a greedy rollout of their own play it at random.
+template <typename Game>
+typename Game::move_type greedy_move(const Game &board, const typename Game::move_type *moves, int count,
+                                     std::mt19937 &rng) {
+    return moves[rng() % count];
+}
+
+// Pick a rollout move that wins a tile if there is one. Otherwise, prefer moves that
+// do not send the opponent to an open tile where they can win immediately.
+grid_coord greedy_move(const Board &board, const grid_coord *moves, int count, std::mt19937 &rng) {
+    grid_coord safe_moves[81];
+    int safe_count = 0;
+    for (int n = 0; n < count; n++) {
+        const grid_coord &move = moves[n];
+        if (board.wins_tile(move)) {
+            return move;
+        }
+        const tile_info &target = board.tile(move.i, move.j);
+        unsigned short opponent_wins = board.player == PLAYER_X ? target.o_wins : target.x_wins;
+        if (target.winner == PLAYER_NONE && opponent_wins == 0) {
+            safe_moves[safe_count++] = move;
+        }
+    }
+    if (safe_count > 0) {
+        return safe_moves[rng() % safe_count];
+    }
+    return moves[rng() % count];
+}
+
+// Play the board out to the end, or for at most max_moves moves if that is not negative.
+// ROLLOUT_RANDOM picks uniformly; ROLLOUT_GREEDY plays greedy_move.
+template <typename Game> Game simulate(const Game &board, rollout_policy policy, int max_moves = -1) {
+    Game new_board(board);
+    std::mt19937 &rng = rollout_rng();
+    while (new_board.game_winner() == PLAYER_NONE && max_moves-- != 0) {
+        typename Game::move_type s_moves[Game::MAX_MOVES];
+        int count = new_board.get_valid_moves(s_moves);
+        typename Game::move_type move;
+        if (policy == ROLLOUT_GREEDY) {
+            move = greedy_move(new_board, s_moves, count, rng);
+        } else {
+            move = s_moves[rng() % count];
+        }
         new_board.move(move);
     }
     return new_board;
 }
 
-MCTSNode::~MCTSNode() {
+// Erase the node's transposition table entry through its slot, without hashing its position again. Another thread
+// may already have handed the entry to a new node in get_node, or compact to a copy, in which case it is left alone.
+template <typename Game> GameNode<Game>::~GameNode() {
+    tree->tree_lock.lock();
     tree->total_fillicides++;
-    tree->transposition_table.erase(tree->transposition_table.find(board));
+    if (table_slot != NO_SLOT) {
+        weak_ptr<GameNode<Game>> self = this->weak_from_this();
+        weak_ptr<GameNode<Game>> &entry = tree->transposition_table[table_slot];
+        if (!entry.owner_before(self) && !self.owner_before(entry)) {
+            tree->transposition_table.erase(table_slot);
+        }
+    }
+    tree->tree_lock.unlock();
+}
+
+// Run iterations on the calling thread. With virtual_loss set, the path is marked while its leaf is evaluated,
+// which steers other threads searching the same tree elsewhere.
+// The configured selection policy and reward type pick one compiled instantiation of the search loop here, once per
+// call, so nothing inside the loop branches on them.
+template <typename Game> void GameTree<Game>::mcts(const Game &board, int num_iterations, bool virtual_loss) {
+    mcts(board, get_node(board, nullptr), num_iterations, virtual_loss);
+}
+
+// As above, from a root that is already known to hold the board, which saves looking it up in the table.
+template <typename Game>
+void GameTree<Game>::mcts(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations, bool virtual_loss) {
+    switch (config.selection) {
+    case SELECT_UCT:
+        mcts_with<UCT>(board, root, num_iterations, virtual_loss);
+        break;
+    case SELECT_UCB1_TUNED:
+        mcts_with<UCB1Tuned>(board, root, num_iterations, virtual_loss);
+        break;
+    default:
+        mcts_with<PUCT>(board, root, num_iterations, virtual_loss);
+    }
 }
 
-void MCTSTree::mcts(const Board &board, int num_iterations) {
-    shared_ptr<MCTSNode> node = get_node(board, nullptr);
+template <typename Game>
+template <typename Policy>
+void GameTree<Game>::mcts_with(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations,
+                               bool virtual_loss) {
+    if (config.reward == REWARD_CONTEMPT) {
+        mcts_with<Policy, Contempt>(board, root, num_iterations, virtual_loss);
+    } else {
+        mcts_with<Policy, WinTieLoss>(board, root, num_iterations, virtual_loss);
+    }
+}
+
+template <typename Game>
+template <typename Policy, typename Reward>
+void GameTree<Game>::mcts_with(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations,
+                               bool virtual_loss) {
+    GameNode<Game> *node = root.get();
+    if (config.evaluator != nullptr && config.batch_size > 1) {
+        batched_mcts<Policy, Reward>(board, root, num_iterations);
+        return;
+    }
+    vector<GameNode<Game> *> path;
+    path.reserve(Game::MAX_MOVES + 1);
     for (int it = 0; it < num_iterations; it++) {
-        vector<shared_ptr<MCTSNode>> path = node->select();
-        shared_ptr<MCTSNode> leaf = path.back();
-        auto board = simulate(leaf->board);
-        leaf->backpropagate(board, path);
-        if (leaf->board.game_winner() == PLAYER_NONE) {
-            leaf->expand();
-        }
-    }
-}
-/**void MCTSTree::parallel_mcts(const Board &board, int num_iterations) {
-    shared_ptr<MCTSNode> node = get_node(board, nullptr);
-    int remaining = num_iterations;
-    int n_threads = thread::hardware_concurrency() - 1;
-    n_threads = n_threads < 1 ? 1 : n_threads;
-    int block_sz = num_iterations / n_threads;
-    vector<thread *> workers;
-    while (remaining > 0) {
-        int block = min(block_sz, remaining);
-        workers.push_back(new thread(mcts, node, block));
-        remaining -= block;
-    }
-    for (thread *worker : workers) {
-        worker->join();
-        delete worker;
-    }
-}**/
\ No newline at end of file
+        EpochGuard pin(reclaimer);
+        Game leaf_board(board);
+        node->template select<Policy>(leaf_board, path);
+        GameNode<Game> *leaf = path.back();
+        if (virtual_loss) {
+            GameNode<Game>::add_virtual_loss(path, 1);
+        }
+        float value = evaluate<Reward>(leaf, leaf_board, board.player);
+        if (virtual_loss) {
+            GameNode<Game>::add_virtual_loss(path, -1);
+        }
+        GameNode<Game>::backpropagate(value, leaf_board.player, path);
+        if (leaf_board.game_winner() == PLAYER_NONE) {
+            leaf->expand(leaf_board);
+        }
+    }
+}
+// Estimate the expected reward for the player to move in board, the leaf's position, with finished games scored by
+// Reward for a search from root_player's turn.
+// Depending on the configuration this is a rollout, the evaluator's value, or a mix of the two.
+// Evaluators with priors also seed the leaf's priors before it is expanded.
+template <typename Game>
+template <typename Reward>
+float GameTree<Game>::evaluate(GameNode<Game> *leaf, const Game &board, char root_player) {
+    char winner = board.game_winner();
+    if (winner != PLAYER_NONE) {
+        return Reward::outcome(winner, board.player, root_player);
+    }
+    if (config.evaluator == nullptr) {
+        Game end = simulate(board, config.rollout);
+        return Reward::outcome(end.game_winner(), board.player, root_player);
+    }
+    float policy_logits[Game::MAX_MOVES];
+    float value = config.evaluator->evaluate(board, policy_logits);
+    if (config.evaluator->has_priors()) {
+        leaf->set_priors(board, policy_logits);
+    }
+    return mix_rollout<Reward>(board, value, root_player);
+}
+
+// Blend an evaluator's value for the board's player to move with a rollout, as set by eval_weight.
+// Rollouts cut short by rollout_depth are scored by the evaluator where they stop.
+template <typename Game>
+template <typename Reward>
+float GameTree<Game>::mix_rollout(const Game &board, float value, char root_player) {
+    float weight = config.eval_weight;
+    if (weight >= 1) {
+        return value;
+    }
+    Game end = simulate(board, config.rollout, config.rollout_depth > 0 ? config.rollout_depth : -1);
+    char winner = end.game_winner();
+    float rollout_value;
+    if (winner != PLAYER_NONE) {
+        rollout_value = Reward::outcome(winner, board.player, root_player);
+    } else {
+        float end_value = config.evaluator->evaluate(end, nullptr);
+        rollout_value = end.player == board.player ? end_value : 1 - end_value;
+    }
+    return weight * value + (1 - weight) * rollout_value;
+}
+
+// A selection that has reached a leaf and is suspended until its evaluation comes back.
+template <typename Game> struct pending_leaf {
+    vector<GameNode<Game> *> path;
+    Game board; // The leaf's position.
+};
+
+// Like mcts, but selections are suspended in a queue with virtual loss along their paths
+// until batch_size leaves have been gathered. The batch goes to the evaluator in one call,
+// then each selection is resumed in order: priors, backpropagation and expansion.
+// Terminal leaves need no evaluation and are resolved as soon as they are selected.
+template <typename Game>
+template <typename Policy, typename Reward>
+void GameTree<Game>::batched_mcts(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations) {
+    GameNode<Game> *node = root.get();
+    // Slots are reused from batch to batch, keeping the buffers of their paths.
+    vector<pending_leaf<Game>> pending(config.batch_size);
+    vector<const Game *> boards;
+    vector<float> values;
+    vector<float> policy_logits;
+    int it = 0;
+    while (it < num_iterations) {
+        EpochGuard pin(reclaimer);
+        int count = 0;
+        boards.clear();
+        while (it < num_iterations && count < config.batch_size) {
+            it++;
+            pending_leaf<Game> &slot = pending[count];
+            slot.board = board;
+            node->template select<Policy>(slot.board, slot.path);
+            GameNode<Game> *leaf = slot.path.back();
+            if (slot.board.game_winner() != PLAYER_NONE) {
+                GameNode<Game>::backpropagate(evaluate<Reward>(leaf, slot.board, board.player), slot.board.player,
+                                              slot.path);
+                continue;
+            }
+            GameNode<Game>::add_virtual_loss(slot.path, 1);
+            count++;
+        }
+        if (count == 0) {
+            continue;
+        }
+        for (int k = 0; k < count; k++) {
+            boards.push_back(&pending[k].board);
+        }
+        values.resize(count);
+        policy_logits.resize(Game::MAX_MOVES * count);
+        config.evaluator->evaluate_batch(boards.data(), count, values.data(), policy_logits.data());
+        for (int k = 0; k < count; k++) {
+            const vector<GameNode<Game> *> &path = pending[k].path;
+            const Game &leaf_board = pending[k].board;
+            GameNode<Game> *leaf = path.back();
+            if (config.evaluator->has_priors()) {
+                leaf->set_priors(leaf_board, &policy_logits[Game::MAX_MOVES * k]);
+            }
+            GameNode<Game>::add_virtual_loss(path, -1);
+            GameNode<Game>::backpropagate(mix_rollout<Reward>(leaf_board, values[k], board.player), leaf_board.player,
+                                          path);
+            leaf->expand(leaf_board);
+        }
+    }
+}
+
+// Search the board within the configured budget, trim the tree down to what can still be reached,
+// and return the best move found.
+template <typename Game>
+typename GameTree<Game>::move_type GameTree<Game>::choose_move(const Game &board) {
+    return choose_move(board, get_node(board, nullptr));
+}
+
+// As above, for a root that is already known to hold the board.
+template <typename Game>
+typename GameTree<Game>::move_type GameTree<Game>::choose_move(const Game &board, shared_ptr<GameNode<Game>> root) {
+    start_search(board, root, false);
+    while (search_slice()) {
+    }
+    return stop_search().move;
+}
+
+template <typename Game>
+void GameTree<Game>::start_search(const Game &board, bool background) {
+    start_search(board, get_node(board, nullptr), background);
+}
+
+// Begin searching from the root, which holds the board, within the configured iteration and time budget, or until
+// the deadline if that comes first, and return at once. Each poll_search call runs one slice of the search unless it
+// is in the background, where something else (usually a SearchScheduler) calls search_slice instead.
+template <typename Game>
+void GameTree<Game>::start_search(const Game &board, shared_ptr<GameNode<Game>> root, bool background,
+                                  std::chrono::steady_clock::time_point deadline) {
+    stop_pondering();
+    stop_search();
+    std::lock_guard<std::mutex> guard(search_lock);
+    search_root = root;
+    search_board = board;
+    search_iterations = 0;
+    search_budget = config.iterations;
+    search_prune_at = config.max_nodes;
+    search_deadline = config.time_ms > 0
+                          ? std::chrono::steady_clock::now() + std::chrono::milliseconds(config.time_ms)
+                          : std::chrono::steady_clock::time_point::max();
+    search_deadline = min(search_deadline, deadline);
+    search_polled = !background;
+    search_id++;
+    searching = true;
+}
+
+// Run one slice of the current search. Returns false once there is nothing left to run.
+// With an id (see search_id) the slice only runs if that search is still the current one.
+// Slices, polls and stops of the same tree take search_lock, so they may come from different threads. The budget
+// is the one start_search copied, so callers may change config.iterations for their next search meanwhile.
+template <typename Game> bool GameTree<Game>::search_slice(long long id) {
+    std::lock_guard<std::mutex> guard(search_lock);
+    int remaining = search_budget - search_iterations;
+    if (id >= 0 && id != search_id) {
+        return false;
+    }
+    if (!searching || remaining <= 0 || std::chrono::steady_clock::now() >= search_deadline) {
+        searching = false;
+        return false;
+    }
+    int block = min(SEARCH_SLICE, remaining);
+    if (config.parallel) {
+        parallel_mcts(search_board, search_root, block);
+    } else {
+        mcts(search_board, search_root, block);
+    }
+    search_iterations += block;
+    // A search that outgrows the node budget prunes between slices, down to half the budget and around the subtree
+    // it is searching. That subtree may hold more than the budget itself, so the next prune waits until the tree has
+    // grown by another half budget, not until it is just over it again.
+    if (transposition_size() > search_prune_at) {
+        prune(config.max_nodes / 2, search_root, true);
+        search_prune_at = std::max<unsigned>(config.max_nodes, transposition_size() + config.max_nodes / 2);
+    }
+    return true;
+}
+
+// Report the current best move of a search, first running a slice of it if it is not in the background.
+template <typename Game> game_status<Game> GameTree<Game>::poll_search() {
+    if (search_polled) {
+        search_slice();
+    }
+    std::lock_guard<std::mutex> guard(search_lock);
+    if (search_root == nullptr) {
+        return game_status<Game>{Game::NO_MOVE, TIE_REWARD, 0, true};
+    }
+    return game_status<Game>{search_root->get_move(false), search_root->Q(), search_iterations, !searching};
+}
+
+// Stop the current search, trim the tree down to what can still be reached from its root and report the result.
+// If there was a search and searched is given, the position it searched is copied there.
+template <typename Game> game_status<Game> GameTree<Game>::stop_search(Game *searched) {
+    searching = false;
+    std::lock_guard<std::mutex> guard(search_lock);
+    if (search_root == nullptr) {
+        return game_status<Game>{Game::NO_MOVE, TIE_REWARD, 0, true};
+    }
+    if (searched != nullptr) {
+        *searched = search_board;
+    }
+    shared_ptr<GameNode<Game>> node = search_root;
+    search_root = nullptr;
+    fill_results(node);
+    node->prune_ancestors();
+    node->prune_children();
+    reclaimer.collect();
+    if (verbose) {
+        printf("Overall transposition hitrate: %f\n", transposition_hitrate());
+        printf("Total node autopurges: %lld\n", purges());
+    }
+    if (transposition_size() > config.max_nodes) {
+        if (verbose) {
+            printf("Transposition table too big, doing drastic prune!\n");
+        }
+        prune(config.max_nodes / 2, node);
+        if (verbose) {
+            printf("New total node purges: %lld\n", purges());
+        }
+    }
+    if (verbose) {
+        printf("Overall transposition size: %d\n", transposition_size());
+    }
+    game_status<Game> status{node->get_move(), node->Q(), search_iterations, true};
+    node = nullptr;
+    if (config.compact_below > 0 && !pondering && arena->live() < config.compact_below * arena->reserved()) {
+        if (verbose) {
+            printf("Compacting %zu live of %zu arena bytes\n", arena->live(), arena->reserved());
+        }
+        compact();
+    }
+    return status;
+}
+
+// Copy the root's per-move statistics and principal variation into results.
+template <typename Game> void GameTree<Game>::fill_results(shared_ptr<GameNode<Game>> root) {
+    results = {};
+    results.iterations = search_iterations;
+    results.root_visits = root->visits;
+    results.root_value = root->Q();
+    root->lock.lock();
+    for (int n = 0; n < root->children.size(); n++) {
+        int cell = Game::move_index(root->moves[n]);
+        results.visits[cell] = root->children[n]->visits;
+        results.value[cell] = 1 - root->children[n]->Q();
+        results.priors[cell] = root->priors == nullptr ? 0 : root->priors[n];
+    }
+    root->lock.unlock();
+    shared_ptr<GameNode<Game>> node = root;
+    while (results.pv_length < PV_LENGTH) {
+        node->lock.lock();
+        int best = -1;
+        for (int n = 0; n < node->children.size(); n++) {
+            if (best == -1 || node->children[n]->visits > node->children[best]->visits) {
+                best = n;
+            }
+        }
+        shared_ptr<GameNode<Game>> next = best == -1 ? nullptr : node->children[best];
+        if (next != nullptr) {
+            results.pv[results.pv_length++] = Game::move_index(node->moves[best]);
+        }
+        node->lock.unlock();
+        if (next == nullptr || next->visits == 0) {
+            break;
+        }
+        node = next;
+    }
+}
+
+// Make the empty board the current position of the game this tree follows.
+template <typename Game> void GameTree<Game>::new_game() {
+    stop_pondering();
+    stop_search();
+    position = Game();
+    position_node = get_node(position, nullptr);
+}
+
+// Play a move in the current position. The next node is normally already a child of the current one,
+// so the transposition table is only probed when that part of the tree was never expanded or was pruned.
+// Returns false and leaves the position alone if the move is illegal.
+template <typename Game> bool GameTree<Game>::apply_move(const move_type &move) {
+    if (!position.is_valid_move(move)) {
+        return false;
+    }
+    shared_ptr<GameNode<Game>> next = position_root()->child(move);
+    position.move(move);
+    position_node = next != nullptr ? next : get_node(position, nullptr);
+    return true;
+}
+
+// The node of the current position.
+template <typename Game> shared_ptr<GameNode<Game>> GameTree<Game>::position_root() {
+    if (position_node == nullptr) {
+        position_node = get_node(position, nullptr);
+    }
+    return position_node;
+}
+
+// Keep searching the board in the background on the shared pool until stop_pondering is called or the tree is full.
+// Every opponent reply is a child of the board, so the next search finds its subtree already searched
+// and prunes everything else away as it re-roots there.
+template <typename Game> void GameTree<Game>::start_pondering(const Game &board) {
+    stop_pondering();
+    if (board.game_winner() != PLAYER_NONE) {
+        return;
+    }
+    pondering = true;
+    shared_ptr<GameNode<Game>> root = get_node(board, nullptr);
+    shared_pool().run(ponder_tasks, [this, board, root]() { ponder(board, root); });
+}
+
+// Run one slice of pondering, then queue the next, so pondering gives its worker back to the pool between slices.
+template <typename Game> void GameTree<Game>::ponder(const Game &board, shared_ptr<GameNode<Game>> root) {
+    if (!pondering || transposition_size() >= config.max_nodes) {
+        return;
+    }
+    mcts(board, root, PONDER_SLICE);
+    shared_pool().run(ponder_tasks, [this, board, root]() { ponder(board, root); });
+}
+
+// Cancel pondering and wait for the current slice of iterations to finish.
+// The tree must not be searched or read by anyone else while pondering.
+template <typename Game> void GameTree<Game>::stop_pondering() {
+    pondering = false;
+    if (ponder_tasks.pending > 0) {
+        shared_pool().wait(ponder_tasks);
+    }
+}
+
+// Spread the iterations over the shared pool in small chunks that idle workers steal from each other, since some
+// chunks run into much deeper or slower subtrees than others. Every chunk searches the same tree with virtual loss.
+template <typename Game>
+void GameTree<Game>::parallel_mcts(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations) {
+    ThreadPool &pool = shared_pool();
+    task_group group;
+    for (int start = 0; start < num_iterations; start += PARALLEL_CHUNK) {
+        int block = min(PARALLEL_CHUNK, num_iterations - start);
+        pool.run(group, [this, board, root, block]() { mcts(board, root, block, true); });
+    }
+    pool.wait(group);
+}
+
+template class GameTree<Board>;
+template class GameNode<Board>;
+template class GameTree<TicTacToe>;
+template class GameNode<TicTacToe>;
@@ -1,74 +1,274 @@
 #ifndef MCTS_H
 #define MCTS_H
 #include "board.h"
+#include "epoch.h"
+#include "evaluator.h"
+#include "node_arena.h"
+#include "parent_list.h"
+#include "relaxed.h"
+#include "spin_lock.h"
+#include "thread_pool.h"
+#include "transposition_table.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <limits>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <random>
 #include <shared_mutex>
 #include <stdlib.h>
 #include <thread>
 #include <time.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using std::thread, std::unordered_map, std::find, std::shared_ptr, std::weak_ptr, std::pair, std::recursive_mutex,
     std::queue, std::uniform_int_distribution, std::min, std::make_shared, std::enable_shared_from_this, std::sqrt, std::find;
 
+// Ask for the cache line holding address ahead of a read, where the compiler supports it. Only a hint: the address
+// need not be valid.
+inline void prefetch(const void *address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#endif
+}
+
+// The reward of a tie, and the value reported when there is nothing to search.
+const float TIE_REWARD = 0.5;
+
 typedef struct _float_grid_wrapper {
     float policy[9][9];
 } policy_vec;
 
-class MCTSNode;
+enum rollout_policy { ROLLOUT_RANDOM, ROLLOUT_GREEDY };
+// The policies and reward types themselves live in policies.h.
+enum selection_policy { SELECT_PUCT, SELECT_UCT, SELECT_UCB1_TUNED };
+enum reward_type { REWARD_WIN_TIE_LOSS, REWARD_CONTEMPT };
+enum backup_mode { BACKUP_PATH, BACKUP_GRAPH };
+
+// The search runs on any game type that provides, as Board and TicTacToe do:
+//   move_type, MAX_MOVES (a bound on legal moves) and a static move_index(move) below MAX_MOVES,
+//   int get_valid_moves(move_type moves[MAX_MOVES]) const, writing the legal moves and returning their count,
+//   bool is_valid_move(move) const and bool move(move), which plays a move for the side to move,
+//   char game_winner() const and char player, the side to move, both in PLAYER_* values,
+//   a default constructor for the starting position, copying, operator== and std::hash.
+// Selection rebuilds the position of every node it visits by playing moves on a copy of the root's, so nothing is
+// ever unmade.
+// Every game is compiled separately (see the instantiations at the end of mcts.cpp); MCTSTree is the ultimate
+// tic-tac-toe one.
+
+// Nodes normally keep a copy of their position, which also keys the transposition table. Building with
+// MCTS_LEAN_NODES drops that copy: the table is keyed by the position's 64 bit key() instead, and nodes keep a second,
+// independent 64 bit check() to tell apart positions whose keys collide. Games then also provide those two hashes.
+#ifdef MCTS_LEAN_NODES
+template <typename Game> using table_key = unsigned long long;
+template <typename Game> unsigned long long position_key(const Game &board) { return board.key(); }
+#else
+template <typename Game> using table_key = Game;
+template <typename Game> const Game &position_key(const Game &board) { return board; }
+#endif
+
+// Everything that distinguishes one engine configuration from another.
+// A search stops at whichever of iterations or time_ms (if nonzero) runs out first.
+// With an evaluator, leaf values are eval_weight * evaluation + (1 - eval_weight) * rollout,
+// and the rollout is skipped entirely when eval_weight is 1.
+// A nonzero rollout_depth truncates those rollouts and scores where they stop with the evaluator.
+// A batch_size above 1 gathers that many leaves per evaluator call (see MCTSTree::batched_mcts).
+// With ponder set, callers hand the position after their move to MCTSTree::start_pondering.
+// With parallel set, every search slice is spread over the shared thread pool (see MCTSTree::parallel_mcts).
+// selection picks the formula that chooses children during descent, and reward how finished games are scored.
+// backup decides how values flow up after an evaluation (see GameNode::backpropagate).
+// A nonzero compact_below allocates nodes from an arena (see NodeArena) and compacts the tree once a finished search
+// leaves less than that fraction of the arena live (see MCTSTree::compact). At 0 nodes live on the ordinary heap.
+template <typename Game> struct game_config {
+    int iterations = 10000;
+    int time_ms = 0;
+    float c = 1.44;
+    rollout_policy rollout = ROLLOUT_RANDOM;
+    unsigned max_nodes = 500000;
+    GameEvaluator<Game> *evaluator = nullptr;
+    float eval_weight = 1.0;
+    int rollout_depth = 0;
+    int batch_size = 1;
+    bool ponder = false;
+    bool parallel = false;
+    selection_policy selection = SELECT_PUCT;
+    reward_type reward = REWARD_WIN_TIE_LOSS;
+    backup_mode backup = BACKUP_PATH;
+    float compact_below = 0;
+};
+
+// Progress of a search started by MCTSTree::start_search.
+template <typename Game> struct game_status {
+    typename Game::move_type move; // Best move so far, or all -1 before the root has children.
+    float value;                   // Expected reward for the player to move at the root.
+    int iterations;                // Iterations run so far.
+    bool done;                     // The iteration or time budget has run out, or the search was stopped.
+};
+
+// Root statistics of the last finished search, kept at a fixed address so callers can read them in place.
+// Every field is 4 bytes wide, so wasm callers can view the buffer through HEAP32 and HEAPF32.
+// Per-move arrays are indexed by Game::move_index, which for Board is 9 * row + column of the full grid, and hold
+// zeros for illegal moves.
+// value is the expected reward of a move for the player to move at the root; priors are zero without an evaluator
+// that provides them. The principal variation follows the most visited child and stores moves the same way.
+const int PV_LENGTH = 16;
+template <typename Game> struct game_stats {
+    int iterations;
+    int root_visits;
+    float root_value;
+    int pv_length;
+    int pv[PV_LENGTH];
+    int visits[Game::MAX_MOVES];
+    float value[Game::MAX_MOVES];
+    float priors[Game::MAX_MOVES];
+};
+
+template <typename Game> class GameNode;
 
-class MCTSTree {
+template <typename Game> class GameTree {
   public:
-    vector<shared_ptr<MCTSNode>> roots;
+    typedef typename Game::move_type move_type;
+    vector<shared_ptr<GameNode<Game>>> roots;
     recursive_mutex tree_lock;
-    unordered_map<Board, weak_ptr<MCTSNode>> transposition_table;
+    TranspositionTable<table_key<Game>, weak_ptr<GameNode<Game>>> transposition_table;
     long long total_lookups = 0;
     long long total_hits = 0;
     long long total_fillicides = 0;
-    shared_ptr<MCTSNode> get_node(const Board &new_board, shared_ptr<MCTSNode> new_parent);
+    game_config<Game> config;
+    bool verbose = true;
+    task_group ponder_tasks;
+    std::atomic<bool> pondering{false};
+    std::mutex search_lock;
+    std::atomic<bool> searching{false};
+    bool search_polled = true;
+    long long search_id = 0;
+    std::atomic<int> search_iterations{0};
+    int search_budget = 0; // config.iterations when the search started.
+    unsigned search_prune_at = 0; // The table size past which the search next prunes.
+    shared_ptr<GameNode<Game>> search_root;
+    Game search_board;
+    std::chrono::steady_clock::time_point search_deadline;
+    game_stats<Game> results = {};
+    Game position;
+    shared_ptr<GameNode<Game>> position_node;
+    shared_ptr<NodeArena> arena = make_shared<NodeArena>();
+    std::mutex prune_lock;
+    // Search threads pin an epoch per iteration, and pruning retires the children it drops here, so nodes are only
+    // freed once no selection can still be walking through them. Declared last so it is destroyed first, while the
+    // table the freed nodes erase themselves from still exists.
+    EpochReclaimer reclaimer;
+    ~GameTree();
+    shared_ptr<GameNode<Game>> get_node(const Game &new_board, shared_ptr<GameNode<Game>> new_parent);
+    shared_ptr<GameNode<Game>> get_node(const Game &new_board, shared_ptr<GameNode<Game>> new_parent, size_t hash);
+    void prefetch_nodes(const size_t *hashes, int count);
     float transposition_hitrate();
     int transposition_size();
     long long purges();
-    void mcts(const Board &board, int num_iterations);
-    void parallel_mcts(const Board &board, int num_iterations);
-    void prune(unsigned max_size);
+    size_t memory_usage();
+    void mcts(const Game &board, int num_iterations, bool virtual_loss = false);
+    void mcts(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations, bool virtual_loss = false);
+    template <typename Policy>
+    void mcts_with(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations, bool virtual_loss);
+    template <typename Policy, typename Reward>
+    void mcts_with(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations, bool virtual_loss);
+    template <typename Policy, typename Reward>
+    void batched_mcts(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations);
+    void parallel_mcts(const Game &board, shared_ptr<GameNode<Game>> root, int num_iterations);
+    void prune(unsigned max_size, shared_ptr<GameNode<Game>> keep, bool keep_subtree = false);
+    void compact();
+    template <typename Reward> float evaluate(GameNode<Game> *leaf, const Game &board, char root_player);
+    template <typename Reward> float mix_rollout(const Game &board, float value, char root_player);
+    move_type choose_move(const Game &board);
+    move_type choose_move(const Game &board, shared_ptr<GameNode<Game>> root);
+    void start_search(const Game &board, bool background);
+    void start_search(const Game &board, shared_ptr<GameNode<Game>> root, bool background,
+                      std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+    bool search_slice(long long id = -1);
+    game_status<Game> poll_search();
+    game_status<Game> stop_search(Game *searched = nullptr);
+    void fill_results(shared_ptr<GameNode<Game>> root);
+    void new_game();
+    bool apply_move(const move_type &move);
+    shared_ptr<GameNode<Game>> position_root();
+    void start_pondering(const Game &board);
+    void ponder(const Game &board, shared_ptr<GameNode<Game>> root);
+    void stop_pondering();
 };
 
-class MCTSNode : public enable_shared_from_this<MCTSNode> {
+template <typename Game> class GameNode : public enable_shared_from_this<GameNode<Game>> {
   public:
-    Board board;
-    MCTSTree *tree;
-    vector<weak_ptr<MCTSNode>> parents;
-    vector<shared_ptr<MCTSNode>> children;
-    vector<grid_coord> moves;
-    unsigned visits = 0;
-    unsigned wins = 0;
-    unsigned ties = 0;
-    bool expanded = false;
-    mutable recursive_mutex lock;
+    typedef typename Game::move_type move_type;
+    // The fields come in cache line sized groups: on 64 bit targets a node with a full board spans five lines, and a
+    // lean one three.
+    // Cold: only read when the node is re-rooted or pruned, or a transposition adds a parent.
+#ifdef MCTS_LEAN_NODES
+    unsigned long long hash;  // The position's key().
+    unsigned long long check; // The position's check().
+#else
+    Game board;
+#endif
+    unsigned table_slot = NO_SLOT; // Where the node's transposition table entry is, if it has one.
+    SpinLock parents_lock;         // Only guards parents, and is never held while taking another lock.
+    ParentList<GameNode> parents;  // Roots have none.
+    // Hot: the statistics a parent reads for every child it scores and backpropagation writes, together with the
+    // lock writers take. Readers such as selection load them without it (see Relaxed), and visits, which selection
+    // counts before any lock is taken, is incremented atomically. Each of these groups starts its own cache line, so
+    // selection touches one line per child, and threads updating one node's statistics never invalidate the lines of
+    // a node another thread is reading. make_shared places the node on its own 64 byte boundary too, away from the
+    // reference counts.
+    alignas(64) mutable recursive_mutex lock;
+    std::atomic<unsigned> visits{0};
+    Relaxed<float> reward = 0;
+    Relaxed<float> reward_sq = 0;
+    Relaxed<unsigned> virtual_loss = 0;
+    float value = 0; // Mean reward for the player to move, kept by graph backups.
+    std::atomic<bool> expanded{false};
+    char player; // The side to move.
+    // Warm: read when selection descends from this node. Exactly one line.
+    alignas(64) GameTree<Game> *tree;
+    vector<shared_ptr<GameNode>> children;
+    vector<move_type> moves; // Legal moves, listed when first needed and then in the order of children.
+    std::unique_ptr<float[]> priors; // One per move once an evaluator has set them, or nullptr.
     float Q();
     float parent_Q();
-    float U();
-    float PUCT();
-    int ref_count = 0;
-    shared_ptr<MCTSNode> max_PUCT();
-    vector<shared_ptr<MCTSNode>> select();
+    float U(unsigned parent_visits);
+    float PUCT(unsigned parent_visits);
+    template <typename Policy> GameNode *select_child(move_type &move);
+    template <typename Policy> void select(Game &board, vector<GameNode *> &path);
+    static void add_virtual_loss(const vector<GameNode *> &path, int amount);
     void prune_ancestors();
-    void prune_ancestors(shared_ptr<MCTSNode> node_to_keep);
+    void prune_ancestors(shared_ptr<GameNode> node_to_keep);
     void prune_children();
     void filicide();
-    void expand();
-    void backpropagate(const Board &board, vector<shared_ptr<MCTSNode>> path);
-    grid_coord get_move() const;
-    policy_vec get_policy() const;
-    MCTSNode(const Board &board, shared_ptr<MCTSNode> parent, MCTSTree *host);
-    ~MCTSNode();
+    void list_moves(const Game &board);
+    void expand(const Game &board);
+    void set_priors(const Game &board, const float *policy_logits);
+    static void backpropagate(float value, char player, const vector<GameNode *> &path);
+    void refresh_value();
+    move_type get_move(bool enumerate = true) const;
+    shared_ptr<GameNode> child(const move_type &move) const;
+    void get_policy(float policy[Game::MAX_MOVES]) const;
+#ifdef MCTS_LEAN_NODES
+    const table_key<Game> &key() const { return hash; }
+    bool holds(const Game &position) const { return check == position.check(); }
+#else
+    const table_key<Game> &key() const { return board; }
+    bool holds(const Game &position) const { return true; }
+#endif
+    GameNode(const Game &board, shared_ptr<GameNode> parent, GameTree<Game> *host);
+    GameNode(const GameNode &other);
+    ~GameNode();
 };
 
+typedef GameTree<Board> MCTSTree;
+typedef GameNode<Board> MCTSNode;
+typedef game_config<Board> search_config;
+typedef game_status<Board> search_status;
+typedef game_stats<Board> root_stats;
+
 #endif
\ No newline at end of file
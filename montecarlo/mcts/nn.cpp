@@ -0,0 +1,273 @@
+#include "nn.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// Every kernel consumes 8 floats per step, so rows and activations are padded to a multiple of 8.
+const int NN_LANES = 8;
+
+int padded(int n) { return (n + NN_LANES - 1) / NN_LANES * NN_LANES; }
+
+#if defined(__AVX2__)
+float horizontal_sum(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+float dot(const float *w, const float *x, int n) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int k = 0; k < n; k += 8) {
+#if defined(__FMA__)
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(w + k), _mm256_loadu_ps(x + k), acc);
+#else
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(w + k), _mm256_loadu_ps(x + k)));
+#endif
+    }
+    return horizontal_sum(acc);
+}
+
+float dot(const int8_t *w, const float *x, int n) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int k = 0; k < n; k += 8) {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *)(w + k));
+        __m256 wf = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(wf, _mm256_loadu_ps(x + k)));
+    }
+    return horizontal_sum(acc);
+}
+#elif defined(__ARM_NEON)
+float horizontal_sum(float32x4_t v) {
+    float32x2_t sum = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+}
+
+float dot(const float *w, const float *x, int n) {
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    for (int k = 0; k < n; k += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(w + k), vld1q_f32(x + k));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(w + k + 4), vld1q_f32(x + k + 4));
+    }
+    return horizontal_sum(vaddq_f32(acc0, acc1));
+}
+
+float dot(const int8_t *w, const float *x, int n) {
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    for (int k = 0; k < n; k += 8) {
+        int16x8_t wide = vmovl_s8(vld1_s8(w + k));
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(wide)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(wide)));
+        acc0 = vmlaq_f32(acc0, lo, vld1q_f32(x + k));
+        acc1 = vmlaq_f32(acc1, hi, vld1q_f32(x + k + 4));
+    }
+    return horizontal_sum(vaddq_f32(acc0, acc1));
+}
+#elif defined(__wasm_simd128__)
+float horizontal_sum(v128_t v) {
+    return wasm_f32x4_extract_lane(v, 0) + wasm_f32x4_extract_lane(v, 1) + wasm_f32x4_extract_lane(v, 2) +
+           wasm_f32x4_extract_lane(v, 3);
+}
+
+float dot(const float *w, const float *x, int n) {
+    v128_t acc0 = wasm_f32x4_splat(0);
+    v128_t acc1 = wasm_f32x4_splat(0);
+    for (int k = 0; k < n; k += 8) {
+        acc0 = wasm_f32x4_add(acc0, wasm_f32x4_mul(wasm_v128_load(w + k), wasm_v128_load(x + k)));
+        acc1 = wasm_f32x4_add(acc1, wasm_f32x4_mul(wasm_v128_load(w + k + 4), wasm_v128_load(x + k + 4)));
+    }
+    return horizontal_sum(wasm_f32x4_add(acc0, acc1));
+}
+
+float dot(const int8_t *w, const float *x, int n) {
+    v128_t acc0 = wasm_f32x4_splat(0);
+    v128_t acc1 = wasm_f32x4_splat(0);
+    for (int k = 0; k < n; k += 8) {
+        v128_t wide = wasm_i16x8_extend_low_i8x16(wasm_v128_load64_zero(w + k));
+        v128_t lo = wasm_f32x4_convert_i32x4(wasm_i32x4_extend_low_i16x8(wide));
+        v128_t hi = wasm_f32x4_convert_i32x4(wasm_i32x4_extend_high_i16x8(wide));
+        acc0 = wasm_f32x4_add(acc0, wasm_f32x4_mul(lo, wasm_v128_load(x + k)));
+        acc1 = wasm_f32x4_add(acc1, wasm_f32x4_mul(hi, wasm_v128_load(x + k + 4)));
+    }
+    return horizontal_sum(wasm_f32x4_add(acc0, acc1));
+}
+#else
+template <typename T> float dot(const T *w, const float *x, int n) {
+    float acc[NN_LANES] = {0};
+    for (int k = 0; k < n; k += NN_LANES) {
+        for (int l = 0; l < NN_LANES; l++) {
+            acc[l] += w[k + l] * x[k + l];
+        }
+    }
+    float sum = 0;
+    for (int l = 0; l < NN_LANES; l++) {
+        sum += acc[l];
+    }
+    return sum;
+}
+#endif
+
+// Encode the board from the point of view of the player to move.
+void encode_board(const Board &board, float features[NN_INPUTS]) {
+    char me = board.player;
+    char them = me == PLAYER_X ? PLAYER_O : PLAYER_X;
+    memset(features, 0, NN_INPUTS * sizeof(float));
+    for (int i = 0; i < 9; i++) {
+        for (int j = 0; j < 9; j++) {
+            features[9 * i + j] = board.board[i][j] == me;
+            features[81 + 9 * i + j] = board.board[i][j] == them;
+        }
+    }
+    for (int m_i = 0; m_i < 3; m_i++) {
+        for (int m_j = 0; m_j < 3; m_j++) {
+            char tile = board.supergrid[m_i][m_j];
+            features[162 + 3 * m_i + m_j] = tile == me;
+            features[171 + 3 * m_i + m_j] = tile == them;
+            features[180 + 3 * m_i + m_j] = tile == PLAYER_TIE;
+        }
+    }
+    if (board.major_tile.i == -1) {
+        features[198] = 1;
+    } else {
+        features[189 + 3 * board.major_tile.i + board.major_tile.j] = 1;
+    }
+}
+
+bool read_values(FILE *file, void *dst, size_t size, size_t count) { return fread(dst, size, count, file) == count; }
+
+// Load the weight file described in nn.h. On failure, the evaluator is left empty and false is returned.
+bool NetworkEvaluator::load(const char *path) {
+    layers.clear();
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        printf("Could not open network %s\n", path);
+        return false;
+    }
+    char magic[4];
+    int32_t layer_count = 0;
+    bool ok = read_values(file, magic, 1, 4) && memcmp(magic, "UTTN", 4) == 0;
+    ok = ok && read_values(file, &layer_count, sizeof(int32_t), 1) && layer_count > 0;
+    int expected_inputs = NN_INPUTS;
+    for (int l = 0; ok && l < layer_count; l++) {
+        int32_t header[3];
+        ok = read_values(file, header, sizeof(int32_t), 3) && header[0] == expected_inputs && header[1] > 0;
+        if (!ok) {
+            break;
+        }
+        dense_layer layer;
+        layer.inputs = header[0];
+        layer.outputs = header[1];
+        layer.stride = padded(layer.inputs);
+        layer.quantized = header[2] == 1;
+        layer.bias.resize(layer.outputs);
+        vector<float> row(layer.inputs);
+        vector<int8_t> qrow(layer.inputs);
+        if (layer.quantized) {
+            layer.scale.resize(layer.outputs);
+            layer.qweights.assign((size_t)layer.outputs * layer.stride, 0);
+            ok = read_values(file, layer.scale.data(), sizeof(float), layer.outputs);
+            for (int o = 0; ok && o < layer.outputs; o++) {
+                ok = read_values(file, qrow.data(), 1, layer.inputs);
+                memcpy(&layer.qweights[(size_t)o * layer.stride], qrow.data(), layer.inputs);
+            }
+        } else {
+            layer.weights.assign((size_t)layer.outputs * layer.stride, 0);
+            for (int o = 0; ok && o < layer.outputs; o++) {
+                ok = read_values(file, row.data(), sizeof(float), layer.inputs);
+                memcpy(&layer.weights[(size_t)o * layer.stride], row.data(), layer.inputs * sizeof(float));
+            }
+        }
+        ok = ok && read_values(file, layer.bias.data(), sizeof(float), layer.outputs);
+        expected_inputs = layer.outputs;
+        layers.push_back(layer);
+    }
+    ok = ok && expected_inputs == NN_OUTPUTS;
+    fclose(file);
+    if (!ok) {
+        printf("Malformed network %s\n", path);
+        layers.clear();
+    }
+    return ok;
+}
+
+// Run the network on count input vectors of NN_INPUTS floats, writing NN_OUTPUTS raw outputs for each.
+// Each weight row is applied to the whole batch before moving on, so it is read from memory once per batch.
+void NetworkEvaluator::forward(const float *inputs, int count, float *outputs) const {
+    // Scratch space is per thread so concurrent searches can share one evaluator.
+    thread_local vector<float> current, next;
+    size_t width = padded(NN_INPUTS);
+    for (const dense_layer &layer : layers) {
+        width = std::max(width, (size_t)padded(layer.outputs));
+    }
+    current.assign(width * count, 0);
+    next.assign(width * count, 0);
+    for (int n = 0; n < count; n++) {
+        memcpy(&current[n * width], inputs + n * NN_INPUTS, NN_INPUTS * sizeof(float));
+    }
+    for (size_t l = 0; l < layers.size(); l++) {
+        const dense_layer &layer = layers[l];
+        bool hidden = l + 1 < layers.size();
+        for (int o = 0; o < layer.outputs; o++) {
+            for (int n = 0; n < count; n++) {
+                float sum;
+                if (layer.quantized) {
+                    sum = layer.scale[o] *
+                          dot(&layer.qweights[(size_t)o * layer.stride], &current[n * width], layer.stride);
+                } else {
+                    sum = dot(&layer.weights[(size_t)o * layer.stride], &current[n * width], layer.stride);
+                }
+                sum += layer.bias[o];
+                next[n * width + o] = hidden && sum < 0 ? 0 : sum;
+            }
+        }
+        for (int n = 0; n < count; n++) {
+            std::fill(next.begin() + n * width + layer.outputs, next.begin() + (n + 1) * width, 0.0f);
+        }
+        current.swap(next);
+    }
+    for (int n = 0; n < count; n++) {
+        memcpy(outputs + n * NN_OUTPUTS, &current[n * width], NN_OUTPUTS * sizeof(float));
+    }
+}
+
+float NetworkEvaluator::evaluate(const Board &board, float policy_logits[81]) {
+    if (layers.empty()) {
+        return 0.5;
+    }
+    float features[NN_INPUTS];
+    float output[NN_OUTPUTS];
+    encode_board(board, features);
+    forward(features, 1, output);
+    if (policy_logits != nullptr) {
+        memcpy(policy_logits, output, 81 * sizeof(float));
+    }
+    return 1.0f / (1.0f + std::exp(-output[81]));
+}
+
+void NetworkEvaluator::evaluate_batch(const Board *const *boards, int count, float *values, float *policy_logits) {
+    if (layers.empty()) {
+        std::fill(values, values + count, 0.5f);
+        return;
+    }
+    thread_local vector<float> features, outputs;
+    features.resize((size_t)count * NN_INPUTS);
+    outputs.resize((size_t)count * NN_OUTPUTS);
+    for (int n = 0; n < count; n++) {
+        encode_board(*boards[n], &features[n * NN_INPUTS]);
+    }
+    forward(features.data(), count, outputs.data());
+    for (int n = 0; n < count; n++) {
+        memcpy(policy_logits + 81 * n, &outputs[n * NN_OUTPUTS], 81 * sizeof(float));
+        values[n] = 1.0f / (1.0f + std::exp(-outputs[n * NN_OUTPUTS + 81]));
+    }
+}
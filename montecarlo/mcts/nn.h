@@ -0,0 +1,45 @@
+#ifndef NN_H
+#define NN_H
+#include "board.h"
+#include "evaluator.h"
+#include <cstdint>
+#include <vector>
+
+// Inputs are from the point of view of the player to move:
+// 81 own cells, 81 opponent cells, 9 own tiles, 9 opponent tiles, 9 tied tiles, 9 forced tile, 1 free move.
+const int NN_INPUTS = 199;
+// 81 policy logits in cell order followed by one value logit.
+const int NN_OUTPUTS = 82;
+
+typedef struct _dense_layer {
+    int inputs;
+    int outputs;
+    int stride; // Row length rounded up to a whole number of SIMD lanes, zero padded.
+    bool quantized;
+    vector<float> weights;
+    vector<int8_t> qweights;
+    vector<float> scale;
+    vector<float> bias;
+} dense_layer;
+
+// A small fully-connected network with ReLU hidden layers, loaded from a weight file.
+//
+// Weight files are little endian:
+//   char magic[4] = "UTTN", int32 layer_count, then for each layer
+//   int32 inputs, int32 outputs, int32 type (0 = fp32, 1 = int8),
+//   fp32 layers: float weights[outputs][inputs], float bias[outputs]
+//   int8 layers: float scale[outputs], int8 weights[outputs][inputs], float bias[outputs]
+// The first layer must take NN_INPUTS inputs and the last must produce NN_OUTPUTS outputs.
+class NetworkEvaluator : public Evaluator {
+  public:
+    vector<dense_layer> layers;
+    bool load(const char *path);
+    float evaluate(const Board &board, float policy_logits[81]) override;
+    void evaluate_batch(const Board *const *boards, int count, float *values, float *policy_logits) override;
+    bool has_priors() const override { return !layers.empty(); } // Without layers no logits are written.
+    void forward(const float *inputs, int count, float *outputs) const;
+};
+
+void encode_board(const Board &board, float features[NN_INPUTS]);
+
+#endif
@@ -0,0 +1,35 @@
+#include "node_arena.h"
+#include <algorithm>
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+
+NodeArena::NodeArena(size_t chunk_bytes) : chunk_bytes(chunk_bytes) {}
+
+NodeArena::~NodeArena() {
+    for (char *chunk : chunks) {
+        free(chunk);
+    }
+}
+
+// Carve the next aligned block off the current chunk, starting a new chunk when it does not fit.
+void *NodeArena::allocate(size_t bytes, size_t alignment) {
+    std::lock_guard<std::mutex> guard(lock);
+    uintptr_t start = ((uintptr_t)next + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (next == nullptr || start + bytes > (uintptr_t)end) {
+        size_t size = std::max(chunk_bytes, bytes + alignment);
+        char *chunk = (char *)malloc(size);
+        if (chunk == nullptr) {
+            throw std::bad_alloc();
+        }
+        chunks.push_back(chunk);
+        used_bytes += (end - next);
+        next = chunk;
+        end = chunk + size;
+        start = ((uintptr_t)next + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+    used_bytes += start + bytes - (uintptr_t)next;
+    next = (char *)(start + bytes);
+    live_bytes += bytes;
+    return (void *)start;
+}
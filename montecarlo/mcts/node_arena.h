@@ -0,0 +1,44 @@
+#ifndef NODE_ARENA_H
+#define NODE_ARENA_H
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A bump allocator for the nodes of a tree. Nodes are laid out one after another in large chunks in the order they
+// are created, and memory is never reused: freeing only counts the bytes as dead. Every chunk is returned at once
+// when the arena is destroyed, which happens after its last node is freed, since each node's allocator holds it.
+// Once most of an arena is dead, GameTree::compact copies the live nodes into a fresh one.
+class NodeArena {
+  public:
+    NodeArena(size_t chunk_bytes = 1 << 20);
+    ~NodeArena();
+    void *allocate(size_t bytes, size_t alignment);
+    void deallocate(size_t bytes) { live_bytes -= bytes; }
+    size_t live() const { return live_bytes; }
+    size_t reserved() const { return used_bytes; }
+
+  private:
+    std::mutex lock;
+    std::vector<char *> chunks;
+    size_t chunk_bytes;
+    char *next = nullptr;
+    char *end = nullptr;
+    std::atomic<size_t> used_bytes{0}; // Handed out so far, including alignment padding.
+    std::atomic<size_t> live_bytes{0};
+};
+
+// Allocates from a NodeArena, for std::allocate_shared.
+template <typename T> class arena_allocator {
+  public:
+    typedef T value_type;
+    arena_allocator(std::shared_ptr<NodeArena> arena) : arena(arena) {}
+    template <typename U> arena_allocator(const arena_allocator<U> &other) : arena(other.arena) {}
+    T *allocate(size_t n) { return (T *)arena->allocate(n * sizeof(T), alignof(T)); }
+    void deallocate(T *p, size_t n) { arena->deallocate(n * sizeof(T)); }
+    template <typename U> bool operator==(const arena_allocator<U> &other) const { return arena == other.arena; }
+    template <typename U> bool operator!=(const arena_allocator<U> &other) const { return arena != other.arena; }
+    std::shared_ptr<NodeArena> arena;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "ntuple.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+const int TILE_CLASS[3][3] = {{0, 1, 0}, {1, 2, 1}, {0, 1, 0}};
+// The first tile of each class, whose orientation the class's patterns are read in.
+const int CLASS_TILE[3][2] = {{0, 0}, {0, 1}, {1, 1}};
+
+// Where the cell (i, j) of a 3x3 grid lands under each of the eight symmetries of the square. Applied to tile
+// coordinates, the same symmetry moves whole tiles.
+void symmetric_cell(int symmetry, int i, int j, int &to_i, int &to_j) {
+    int cells[8][2] = {{i, j}, {i, 2 - j}, {2 - i, j}, {2 - i, 2 - j}, {j, i}, {2 - j, i}, {j, 2 - i}, {2 - j, 2 - i}};
+    to_i = cells[symmetry][0];
+    to_j = cells[symmetry][1];
+}
+
+// The pattern each tile index reads as in each tile: the lowest index it turns into under the symmetries of the board
+// that take the tile to the first tile of its class. Every tile of a class thus shares weights in one orientation,
+// and positions that are symmetric to each other read the same patterns.
+unsigned short TILE_PATTERN[9][NTUPLE_TILE_PATTERNS];
+
+bool build_tile_patterns() {
+    for (int tile = 0; tile < 9; tile++) {
+        const int *first = CLASS_TILE[TILE_CLASS[tile / 3][tile % 3]];
+        for (int index = 0; index < NTUPLE_TILE_PATTERNS; index++) {
+            int lowest = NTUPLE_TILE_PATTERNS;
+            for (int symmetry = 0; symmetry < 8; symmetry++) {
+                int to_i, to_j;
+                symmetric_cell(symmetry, tile / 3, tile % 3, to_i, to_j);
+                if (to_i != first[0] || to_j != first[1]) {
+                    continue;
+                }
+                int turned = 0;
+                for (int k = 0, rest = index; k < 9; k++, rest /= 3) {
+                    symmetric_cell(symmetry, k / 3, k % 3, to_i, to_j);
+                    turned += rest % 3 * POW3[3 * to_i + to_j];
+                }
+                lowest = std::min(lowest, turned);
+            }
+            TILE_PATTERN[tile][index] = lowest;
+        }
+    }
+    return true;
+}
+
+const bool tile_patterns_ready = build_tile_patterns();
+const int SUPERGRID_LINES[8][3][2] = {{{0, 0}, {0, 1}, {0, 2}}, {{1, 0}, {1, 1}, {1, 2}}, {{2, 0}, {2, 1}, {2, 2}},
+                                      {{0, 0}, {1, 0}, {2, 0}}, {{0, 1}, {1, 1}, {2, 1}}, {{0, 2}, {1, 2}, {2, 2}},
+                                      {{0, 0}, {1, 1}, {2, 2}}, {{0, 2}, {1, 1}, {2, 0}}};
+
+// Map a cell or tile owner to 0 for nobody, 1 for the player to move, 2 for the opponent and 3 for a tie.
+int relative_owner(char owner, char me) {
+    if (owner == PLAYER_NONE) {
+        return 0;
+    }
+    if (owner == PLAYER_TIE) {
+        return 3;
+    }
+    return owner == me ? 1 : 2;
+}
+
+// List the flat weight index of every feature active in the board.
+void NTupleEvaluator::features(const Board &board, int active[NTUPLE_FEATURES]) const {
+    char me = board.player;
+    int n = 0;
+    for (int m_i = 0; m_i < 3; m_i++) {
+        for (int m_j = 0; m_j < 3; m_j++) {
+            // Tile indices already count X as 1 and O as 2, so they only need swapping when O is to move.
+            unsigned short index = board.tile_index[m_i][m_j];
+            int pattern = TILE_PATTERN[3 * m_i + m_j][me == PLAYER_X ? index : TILE_TABLE[index].swapped];
+            active[n++] = TILE_CLASS[m_i][m_j] * NTUPLE_TILE_PATTERNS + pattern;
+        }
+    }
+    for (int line = 0; line < 8; line++) {
+        int pattern = 0;
+        for (int k = 0; k < 3; k++) {
+            const int *tile = SUPERGRID_LINES[line][k];
+            pattern = 4 * pattern + relative_owner(board.supergrid[tile[0]][tile[1]], me);
+        }
+        active[n++] = NTUPLE_LINE_OFFSET + line * NTUPLE_LINE_PATTERNS + pattern;
+    }
+    int forced = board.major_tile.i == -1 ? 9 : 3 * board.major_tile.i + board.major_tile.j;
+    active[n++] = NTUPLE_FORCED_OFFSET + forced;
+}
+
+float NTupleEvaluator::logit(const int active[NTUPLE_FEATURES]) const {
+    float sum = 0;
+    for (int n = 0; n < NTUPLE_FEATURES; n++) {
+        sum += weights[active[n]];
+    }
+    return sum;
+}
+
+float NTupleEvaluator::evaluate(const Board &board, float policy_logits[81]) {
+    int active[NTUPLE_FEATURES];
+    features(board, active);
+    return 1.0f / (1.0f + std::exp(-logit(active)));
+}
+
+bool NTupleEvaluator::load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        printf("Could not open n-tuple weights %s\n", path);
+        return false;
+    }
+    char magic[4];
+    vector<float> loaded(NTUPLE_WEIGHTS);
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "UTN2", 4) == 0;
+    ok = ok && fread(loaded.data(), sizeof(float), NTUPLE_WEIGHTS, file) == NTUPLE_WEIGHTS;
+    fclose(file);
+    if (!ok) {
+        printf("Malformed n-tuple weights %s\n", path);
+        return false;
+    }
+    weights = loaded;
+    return true;
+}
+
+bool NTupleEvaluator::save(const char *path) const {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        printf("Could not write n-tuple weights %s\n", path);
+        return false;
+    }
+    bool ok = fwrite("UTN2", 1, 4, file) == 4;
+    ok = ok && fwrite(weights.data(), sizeof(float), NTUPLE_WEIGHTS, file) == NTUPLE_WEIGHTS;
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
@@ -0,0 +1,36 @@
+#ifndef NTUPLE_H
+#define NTUPLE_H
+#include "board.h"
+#include "evaluator.h"
+
+// Each tile is one 9-cell tuple (3^9 patterns), with one table per symmetry class: corners, edges and the center.
+// Tiles of a class share their table by first turning their pattern to the orientation of the class's first tile, by
+// the same reflections and rotations of the board that take them there, so a shared weight always describes the same
+// cells relative to the edges of the board.
+// Each supergrid line is one 3-tile tuple (4^3 patterns) with its own table, and the forced tile (or a free move)
+// has a single weight. All tables live in one flat array.
+const int NTUPLE_TILE_PATTERNS = 19683;
+const int NTUPLE_LINE_PATTERNS = 64;
+const int NTUPLE_LINE_OFFSET = 3 * NTUPLE_TILE_PATTERNS;
+const int NTUPLE_FORCED_OFFSET = NTUPLE_LINE_OFFSET + 8 * NTUPLE_LINE_PATTERNS;
+const int NTUPLE_WEIGHTS = NTUPLE_FORCED_OFFSET + 10;
+// Every position activates 9 tile patterns, 8 line patterns and 1 forced tile weight.
+const int NTUPLE_FEATURES = 18;
+
+// A value function made of n-tuple pattern tables.
+// Patterns are read from the point of view of the player to move, so one set of tables serves both players.
+// Evaluation is a table load and add per feature followed by one logistic squash, with no matrix math.
+//
+// Weight files are the magic "UTN2" followed by NTUPLE_WEIGHTS little endian floats. "UTNT" files, which shared
+// tables without turning the patterns, are refused.
+class NTupleEvaluator : public Evaluator {
+  public:
+    vector<float> weights = vector<float>(NTUPLE_WEIGHTS, 0.0f);
+    bool load(const char *path);
+    bool save(const char *path) const;
+    float evaluate(const Board &board, float policy_logits[81]) override;
+    void features(const Board &board, int active[NTUPLE_FEATURES]) const;
+    float logit(const int active[NTUPLE_FEATURES]) const;
+};
+
+#endif
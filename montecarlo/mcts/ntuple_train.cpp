@@ -0,0 +1,136 @@
+// Trains NTupleEvaluator weights by TD(lambda) self-play and saves them to a binary file.
+// Build: g++ -O2 -std=c++17 board.cpp ntuple.cpp ntuple_train.cpp -o ntuple_train
+// Usage: ./ntuple_train games=100000 out=ntuple.bin in=ntuple.bin alpha=0.01 lambda=0.7 epsilon=0.1
+// Every setting is optional; in= resumes from existing weights.
+#include "board.h"
+#include "ntuple.h"
+#include <cmath>
+#include <random>
+#include <string>
+
+using std::string;
+
+typedef struct _train_config {
+    int games = 100000;
+    string in;
+    string out = "ntuple.bin";
+    float alpha = 0.01;
+    float lambda = 0.7;
+    float epsilon = 0.1;
+} train_config;
+
+typedef struct _position_record {
+    int active[NTUPLE_FEATURES];
+    float value;
+} position_record;
+
+float squash(float logit) { return 1.0f / (1.0f + std::exp(-logit)); }
+
+// The value of a board for the player who just moved into it.
+float value_after(const NTupleEvaluator &evaluator, const Board &board, char mover) {
+    char winner = board.game_winner();
+    if (winner == PLAYER_TIE) {
+        return 0.5;
+    } else if (winner != PLAYER_NONE) {
+        return winner == mover ? 1 : 0;
+    }
+    int active[NTUPLE_FEATURES];
+    evaluator.features(board, active);
+    return 1 - squash(evaluator.logit(active));
+}
+
+// Play one epsilon-greedy game with one-ply lookahead, then move every visited position towards its lambda-return.
+// Returns the squared error summed over the game.
+float train_game(NTupleEvaluator &evaluator, const train_config &config, std::mt19937 &rng) {
+    vector<position_record> history;
+    std::uniform_real_distribution<float> coin(0, 1);
+    Board board;
+    float final_value = 0.5;
+    while (board.game_winner() == PLAYER_NONE) {
+        position_record record;
+        evaluator.features(board, record.active);
+        record.value = squash(evaluator.logit(record.active));
+        history.push_back(record);
+
+        vector<grid_coord> moves = board.get_valid_moves();
+        grid_coord best_move = moves[rng() % moves.size()];
+        float best_value = -1;
+        bool explore = coin(rng) < config.epsilon;
+        for (const grid_coord &move : moves) {
+            Board next(board);
+            next.move(move);
+            float value = value_after(evaluator, next, board.player);
+            if (!explore && value > best_value) {
+                best_value = value;
+                best_move = move;
+            }
+        }
+        char mover = board.player;
+        board.move(best_move);
+        final_value = value_after(evaluator, board, mover);
+    }
+
+    // The lambda-return of the last position is the result for its mover. Earlier positions
+    // belong to the other player, so returns flip as they are carried back through the game.
+    float error = 0;
+    float lambda_return = final_value;
+    for (int t = history.size() - 1; t >= 0; t--) {
+        position_record &record = history[t];
+        if (t + 1 < history.size()) {
+            float bootstrap = 1 - history[t + 1].value;
+            lambda_return = (1 - config.lambda) * bootstrap + config.lambda * (1 - lambda_return);
+        }
+        float delta = lambda_return - record.value;
+        error += delta * delta;
+        for (int n = 0; n < NTUPLE_FEATURES; n++) {
+            evaluator.weights[record.active[n]] += config.alpha * delta;
+        }
+    }
+    return error;
+}
+
+int main(int argc, char **argv) {
+    train_config config;
+    for (int arg = 1; arg < argc; arg++) {
+        string setting(argv[arg]);
+        size_t eq = setting.find('=');
+        string key = setting.substr(0, eq);
+        string value = eq == string::npos ? "" : setting.substr(eq + 1);
+        if (key == "games") {
+            config.games = std::stoi(value);
+        } else if (key == "in") {
+            config.in = value;
+        } else if (key == "out") {
+            config.out = value;
+        } else if (key == "alpha") {
+            config.alpha = std::stof(value);
+        } else if (key == "lambda") {
+            config.lambda = std::stof(value);
+        } else if (key == "epsilon") {
+            config.epsilon = std::stof(value);
+        } else {
+            printf("Unknown setting %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    NTupleEvaluator evaluator;
+    if (!config.in.empty() && !evaluator.load(config.in.c_str())) {
+        return 1;
+    }
+    std::mt19937 rng(std::random_device{}());
+    double error = 0;
+    for (int game = 1; game <= config.games; game++) {
+        error += train_game(evaluator, config, rng);
+        if (game % 1000 == 0) {
+            printf("%d games, mean squared TD error per game %f\n", game, error / 1000);
+            error = 0;
+            evaluator.save(config.out.c_str());
+        }
+    }
+    if (!evaluator.save(config.out.c_str())) {
+        return 1;
+    }
+    printf("Saved weights to %s\n", config.out.c_str());
+    return 0;
+}
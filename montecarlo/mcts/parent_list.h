@@ -0,0 +1,72 @@
+#ifndef PARENT_LIST_H
+#define PARENT_LIST_H
+#include <memory>
+#include <vector>
+
+// The weak references from a node to its parents. Nearly every node has exactly one parent, which is kept inline, so
+// the list costs no allocation of its own; only transpositions spill their other parents into a heap array.
+// Takes the space of a vector. Not synchronized: GameNode guards it with parents_lock.
+template <typename T> class ParentList {
+  public:
+    size_t size() const {
+        if (is_empty(first)) {
+            return 0;
+        }
+        return others ? others->size() + 1 : 1;
+    }
+
+    std::weak_ptr<T> &operator[](size_t i) { return i == 0 ? first : (*others)[i - 1]; }
+
+    // Parents given as nullptr, which roots are created with, are not added.
+    void push_back(const std::shared_ptr<T> &parent) {
+        if (parent == nullptr) {
+            return;
+        }
+        if (is_empty(first)) {
+            first = parent;
+            return;
+        }
+        if (!others) {
+            others.reset(new std::vector<std::weak_ptr<T>>());
+        }
+        others->push_back(parent);
+    }
+
+    // Drop the parents that have died, keeping the order of the rest, and free the overflow once it is unused.
+    void remove_expired() {
+        size_t count = size();
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (!(*this)[i].expired()) {
+                if (kept != i) {
+                    (*this)[kept] = std::move((*this)[i]);
+                }
+                kept++;
+            }
+        }
+        if (kept <= 1) {
+            others.reset();
+        } else {
+            others->resize(kept - 1);
+        }
+        if (kept == 0) {
+            first.reset();
+        }
+    }
+
+    // Bytes held outside the node.
+    size_t heap_bytes() const {
+        return others ? sizeof(*others) + others->capacity() * sizeof(std::weak_ptr<T>) : 0;
+    }
+
+  private:
+    std::weak_ptr<T> first;
+    std::unique_ptr<std::vector<std::weak_ptr<T>>> others; // Every parent after the first, if there are any.
+
+    // Whether a reference was never set, as opposed to set and since expired.
+    static bool is_empty(const std::weak_ptr<T> &parent) {
+        return !parent.owner_before(std::weak_ptr<T>()) && !std::weak_ptr<T>().owner_before(parent);
+    }
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef POLICIES_H
+#define POLICIES_H
+#include "board.h"
+#include <algorithm>
+#include <cmath>
+
+// What a selection policy sees of one child, from the point of view of the player choosing between the children.
+typedef struct _child_stats {
+    float mean;          // Mean reward, with pending evaluations counted as losses.
+    float mean_sq;       // Mean squared reward.
+    float prior;         // The evaluator's prior, or 1 without one.
+    float visits;        // Visits of the child.
+    float parent_visits; // Visits of the parent choosing between the children.
+} child_stats;
+
+// Selection policies score children and the search descends into the best one. Each is a struct of static inline
+// functions, so the search core is instantiated once per policy with the formula inlined into it.
+// c scales the exploration term in all of them.
+
+// AlphaZero style PUCT. Without an evaluator every prior is 1. This is the default.
+struct PUCT {
+    static float score(const child_stats &child, float c) {
+        return child.mean + child.prior * c * std::sqrt(child.parent_visits) / (1 + child.visits);
+    }
+};
+
+// Plain UCB1 (UCT). Priors are ignored.
+struct UCT {
+    static float score(const child_stats &child, float c) {
+        return child.mean + c * std::sqrt(std::log(child.parent_visits + 1) / (1 + child.visits));
+    }
+};
+
+// UCB1-Tuned, which shrinks exploration of children whose rewards vary little. Priors are ignored.
+struct UCB1Tuned {
+    static float score(const child_stats &child, float c) {
+        float log_n = std::log(child.parent_visits + 1);
+        float variance = child.mean_sq - child.mean * child.mean + std::sqrt(2 * log_n / (1 + child.visits));
+        return child.mean + c * std::sqrt(log_n / (1 + child.visits) * std::min(0.25f, variance));
+    }
+};
+
+// Reward types score finished games for a player, given the player to move at the root of the search.
+// Rewards stay in [0, 1] and the two players' rewards always sum to 1, so backpropagation can credit one side with
+// r and the other with 1 - r.
+
+// A win is 1, a tie 0.5 and a loss 0. This is the default.
+struct WinTieLoss {
+    static float outcome(char winner, char player, char root_player) {
+        if (winner == PLAYER_TIE) {
+            return 0.5f;
+        }
+        return winner == player ? 1 : 0;
+    }
+};
+
+// Like WinTieLoss, but the player searching rates a tie as a small loss and so plays on for a win.
+struct Contempt {
+    static constexpr float CONTEMPT = 0.1f;
+    static float outcome(char winner, char player, char root_player) {
+        if (winner == PLAYER_TIE) {
+            return player == root_player ? 0.5f - CONTEMPT : 0.5f + CONTEMPT;
+        }
+        return winner == player ? 1 : 0;
+    }
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef RELAXED_H
+#define RELAXED_H
+#include <atomic>
+
+// A value that any thread may read at any time without a lock, through relaxed atomic loads, while writers take
+// whatever lock guards it. Writes are plain relaxed stores, so += and -= are only atomic as a whole when every writer
+// holds that lock. Readers see each value whole, if not always the latest one.
+template <typename T> class Relaxed {
+  public:
+    Relaxed(T initial = T()) : value(initial) {}
+    Relaxed(const Relaxed &other) : value(other) {}
+
+    operator T() const { return value.load(std::memory_order_relaxed); }
+
+    Relaxed &operator=(T other) {
+        value.store(other, std::memory_order_relaxed);
+        return *this;
+    }
+    Relaxed &operator=(const Relaxed &other) { return *this = (T)other; }
+    Relaxed &operator+=(T amount) { return *this = *this + amount; }
+    Relaxed &operator-=(T amount) { return *this = *this - amount; }
+
+  private:
+    std::atomic<T> value;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "scheduler.h"
+
+// A width that is not positive runs as many slices at once as the pool has threads. Nothing touches the pool until
+// the first search is submitted, so builds that never submit one never start its threads.
+SearchScheduler::SearchScheduler(int width) : width(width) {}
+
+// Searches still pending are abandoned where they stand, and the slices already handed to the pool are waited for;
+// their trees can still be stopped as usual.
+SearchScheduler::~SearchScheduler() {
+    lock.lock();
+    stopping = true;
+    pending.clear();
+    lock.unlock();
+    if (slices.pending > 0) {
+        shared_pool().wait(slices);
+    }
+}
+
+// Start a background search of the tree from root, which holds the board, and queue it. The search ends when the
+// tree's own budget runs out or at the deadline, whichever comes first, and on_done is then called on a pool thread.
+// Collect the result with the tree's poll_search and stop_search as for any background search.
+void SearchScheduler::submit(MCTSTree *tree, const Board &board, shared_ptr<MCTSNode> root,
+                             std::chrono::steady_clock::time_point deadline, std::function<void()> on_done) {
+    cancel(tree);
+    tree->start_search(board, root, true, deadline);
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_back(scheduled_search{tree, tree->search_id, deadline, next_sequence++, on_done});
+    dispatch();
+}
+
+// Forget any search queued for the tree and wait for a slice of it that is running to finish.
+// Must be called before a submitted tree is destroyed, unless its search has already called on_done.
+void SearchScheduler::cancel(MCTSTree *tree) {
+    std::unique_lock<std::mutex> guard(lock);
+    auto is_tree = [tree](const scheduled_search &search) { return search.tree == tree; };
+    pending.erase(std::remove_if(pending.begin(), pending.end(), is_tree), pending.end());
+    cancelled.push_back(tree);
+    changed.wait(guard, [&]() { return find(running.begin(), running.end(), tree) == running.end(); });
+    cancelled.erase(find(cancelled.begin(), cancelled.end(), tree));
+}
+
+// Hand the pool a slice task for every pending search that a free slot can take. Called under lock.
+// The tasks do not pick their search until they run, so the earliest deadline is the one served then.
+void SearchScheduler::dispatch() {
+    int slots = width > 0 ? width : shared_pool().size();
+    while (in_flight < slots && unclaimed < pending.size()) {
+        in_flight++;
+        unclaimed++;
+        shared_pool().run(slices, [this]() { run_slice(); });
+    }
+}
+
+void SearchScheduler::run_slice() {
+    std::unique_lock<std::mutex> guard(lock);
+    unclaimed--;
+    if (pending.empty()) {
+        in_flight--;
+        return;
+    }
+    auto earliest = std::min_element(pending.begin(), pending.end(), [](const auto &a, const auto &b) {
+        return a.deadline < b.deadline || (a.deadline == b.deadline && a.sequence < b.sequence);
+    });
+    scheduled_search search = *earliest;
+    pending.erase(earliest);
+    running.push_back(search.tree);
+    guard.unlock();
+
+    bool more = search.tree->search_slice(search.id);
+
+    guard.lock();
+    running.erase(find(running.begin(), running.end(), search.tree));
+    bool dropped = find(cancelled.begin(), cancelled.end(), search.tree) != cancelled.end();
+    if (more && !dropped && !stopping) {
+        search.sequence = next_sequence++;
+        pending.push_back(search);
+    }
+    changed.notify_all();
+    if (!more && !dropped && search.on_done != nullptr) {
+        guard.unlock();
+        search.on_done();
+        guard.lock();
+    }
+    in_flight--;
+    dispatch();
+}
@@ -0,0 +1,45 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include "mcts.h"
+#include <condition_variable>
+#include <functional>
+
+typedef struct _scheduled_search {
+    MCTSTree *tree;
+    long long id; // The tree's search_id when it was submitted.
+    std::chrono::steady_clock::time_point deadline;
+    long long sequence; // Order of (re)submission, which breaks ties between equal deadlines.
+    std::function<void()> on_done;
+} scheduled_search;
+
+// Runs the searches of many independent trees as slices on the shared thread pool (see shared_pool).
+// Each slice task takes the pending search with the earliest deadline, runs one slice of it (see
+// MCTSTree::search_slice) and puts it back, so searches are suspended and resumed between slices and a search closer
+// to its deadline always goes first. Searches with the same deadline (including those without one) take turns in round
+// robin order. At most width slices are queued or running at once, so the deadline order is settled here rather than
+// in the pool's queues. Trees never share state, and a tree is only ever sliced by one task at a time.
+class SearchScheduler {
+  public:
+    SearchScheduler(int width = 0);
+    ~SearchScheduler();
+    void submit(MCTSTree *tree, const Board &board, shared_ptr<MCTSNode> root,
+                std::chrono::steady_clock::time_point deadline, std::function<void()> on_done = nullptr);
+    void cancel(MCTSTree *tree);
+
+  private:
+    vector<scheduled_search> pending;
+    vector<MCTSTree *> running;
+    vector<MCTSTree *> cancelled; // Trees whose running slice must not be queued again.
+    task_group slices;
+    int width;
+    int in_flight = 0; // Slice tasks handed to the pool and not yet finished.
+    size_t unclaimed = 0; // Those of them that have not taken a search yet.
+    std::mutex lock;
+    std::condition_variable changed;
+    long long next_sequence = 0;
+    bool stopping = false;
+    void dispatch();
+    void run_slice();
+};
+
+#endif
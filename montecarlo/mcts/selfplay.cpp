@@ -0,0 +1,142 @@
+// Generates training data by self-play and appends it to a binary file of training_record (see training_data.h).
+// Build: g++ -O2 -std=c++17 -pthread selfplay.cpp board.cpp epoch.cpp mcts.cpp node_arena.cpp ntuple.cpp thread_pool.cpp tictactoe.cpp training_data.cpp -o selfplay
+// Usage: ./selfplay games=10000 threads=8 out=selfplay.bin iterations=800 sample_moves=8
+// Engine settings are iterations, c, rollout (random|greedy) and ntuple (a weight file). The first sample_moves
+// moves of every game are drawn in proportion to root visits instead of taken greedily, so games differ.
+// Each game is written in one piece as soon as it ends, so the file stays valid if the run is interrupted.
+#include "board.h"
+#include "mcts.h"
+#include "ntuple.h"
+#include "training_data.h"
+#include <string>
+
+using std::string, std::mutex;
+
+typedef struct _selfplay_config {
+    int games = 1000;
+    int threads = thread::hardware_concurrency();
+    string out = "selfplay.bin";
+    int sample_moves = 8;
+} selfplay_config;
+
+// The move to the cell at 9 * row + column.
+grid_coord cell_move(int cell) {
+    int row = cell / 9;
+    int column = cell % 9;
+    return grid_coord{row / 3, column / 3, row % 3, column % 3};
+}
+
+// Play one game and return its records, with results filled in once the game is over.
+// A game in which the search comes back without a legal move is dropped, returning no records.
+vector<training_record> play_game(const search_config &config, const selfplay_config &settings) {
+    thread_local std::mt19937 rng(std::random_device{}());
+    vector<training_record> records;
+    MCTSTree tree;
+    tree.verbose = false;
+    tree.config = config;
+    tree.new_game();
+    while (tree.position.game_winner() == PLAYER_NONE) {
+        training_record record;
+        pack_board(tree.position, record);
+        grid_coord move = tree.choose_move(tree.position, tree.position_root());
+        const root_stats &stats = tree.results;
+        long long total = 0;
+        for (int cell = 0; cell < 81; cell++) {
+            total += stats.visits[cell];
+        }
+        for (int cell = 0; cell < 81; cell++) {
+            record.visits[cell] = total > 0 ? stats.visits[cell] * 65535LL / total : 0;
+        }
+        if (records.size() < settings.sample_moves && total > 0) {
+            long long pick = std::uniform_int_distribution<long long>(0, total - 1)(rng);
+            for (int cell = 0; cell < 81; cell++) {
+                pick -= stats.visits[cell];
+                if (pick < 0) {
+                    move = cell_move(cell);
+                    break;
+                }
+            }
+        }
+        records.push_back(record);
+        if (!tree.apply_move(move)) {
+            printf("Search returned illegal move (%d, %d, %d, %d), dropping the game!\n", move.m_i, move.m_j, move.i,
+                   move.j);
+            return vector<training_record>();
+        }
+    }
+    char winner = tree.position.game_winner();
+    for (training_record &record : records) {
+        record.result = winner == PLAYER_TIE ? 0 : (winner == record.player ? 1 : -1);
+    }
+    return records;
+}
+
+int main(int argc, char **argv) {
+    search_config config;
+    config.iterations = 800;
+    selfplay_config settings;
+    NTupleEvaluator ntuple;
+    for (int arg = 1; arg < argc; arg++) {
+        string setting(argv[arg]);
+        size_t eq = setting.find('=');
+        string key = setting.substr(0, eq);
+        string value = eq == string::npos ? "" : setting.substr(eq + 1);
+        if (key == "games") {
+            settings.games = std::stoi(value);
+        } else if (key == "threads") {
+            settings.threads = std::stoi(value);
+        } else if (key == "out") {
+            settings.out = value;
+        } else if (key == "sample_moves") {
+            settings.sample_moves = std::stoi(value);
+        } else if (key == "iterations") {
+            config.iterations = std::stoi(value);
+        } else if (key == "c") {
+            config.c = std::stof(value);
+        } else if (key == "rollout" && value == "random") {
+            config.rollout = ROLLOUT_RANDOM;
+        } else if (key == "rollout" && value == "greedy") {
+            config.rollout = ROLLOUT_GREEDY;
+        } else if (key == "ntuple") {
+            if (!ntuple.load(value.c_str())) {
+                return 1;
+            }
+            config.evaluator = &ntuple;
+        } else {
+            printf("Unknown setting %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    FILE *file = fopen(settings.out.c_str(), "ab");
+    if (file == nullptr) {
+        printf("Could not open %s\n", settings.out.c_str());
+        return 1;
+    }
+    mutex file_lock;
+    int played = 0;
+    long long positions = 0;
+    bool failed = false;
+    ThreadPool &pool = shared_pool(settings.threads);
+    task_group all_games;
+    for (int game = 0; game < settings.games; game++) {
+        pool.run(all_games, [&]() {
+            vector<training_record> records = play_game(config, settings);
+            file_lock.lock();
+            if (!failed && (!write_records(file, records.data(), records.size()) || fflush(file) != 0)) {
+                printf("Could not write to %s\n", settings.out.c_str());
+                failed = true;
+            }
+            played++;
+            positions += records.size();
+            if (played % 10 == 0) {
+                printf("%d/%d games, %lld positions\n", played, settings.games, positions);
+            }
+            file_lock.unlock();
+        });
+    }
+    pool.wait(all_games);
+    failed = fclose(file) != 0 || failed;
+    printf("Appended %lld positions from %d games to %s\n", positions, played, settings.out.c_str());
+    return failed ? 1 : 0;
+}
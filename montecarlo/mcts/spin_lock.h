@@ -0,0 +1,21 @@
+#ifndef SPIN_LOCK_H
+#define SPIN_LOCK_H
+#include <atomic>
+#include <thread>
+
+// A one byte lock for critical sections that are a few instructions long and never take another lock, where the
+// size of a mutex matters more than fairness. Waiters yield between attempts. Works with std::lock_guard.
+class SpinLock {
+  public:
+    void lock() {
+        while (flag.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+    void unlock() { flag.clear(std::memory_order_release); }
+
+  private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+// The pool the current thread works for, and its index there.
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local int current_index = -1;
+
+ThreadPool::ThreadPool(int threads) {
+    threads = threads < 1 ? 1 : threads;
+    for (int t = 0; t < threads; t++) {
+        queues.push_back(std::make_unique<worker_queue>());
+    }
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([this, t]() { work(t); });
+    }
+}
+
+// Tasks still queued are finished before the workers exit.
+ThreadPool::~ThreadPool() {
+    sleep_lock.lock();
+    stopping = true;
+    sleep_lock.unlock();
+    wake.notify_all();
+    for (thread &worker : workers) {
+        worker.join();
+    }
+}
+
+// This thread's worker index in the pool, or -1 for threads outside it.
+int ThreadPool::self() const { return current_pool == this ? current_index : -1; }
+
+// Queue a task in the group. Workers queue on their own deque, everyone else round robin.
+void ThreadPool::run(task_group &group, std::function<void()> task) {
+    int index = self();
+    if (index == -1) {
+        index = next_queue++ % queues.size();
+    }
+    group.pending++;
+    group.queued++;
+    worker_queue &queue = *queues[index];
+    queue.lock.lock();
+    queue.tasks.push_back(pool_task{std::move(task), &group});
+    queue.lock.unlock();
+    queued++;
+    sleep_lock.lock();
+    sleep_lock.unlock();
+    // Everyone, since a thread waiting on this task's group may be the only one that can run it.
+    wake.notify_all();
+}
+
+// Run the group's queued tasks until every task of the group has finished.
+void ThreadPool::wait(task_group &group) {
+    int index = self();
+    while (group.pending > 0) {
+        if (run_one(index, &group)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(sleep_lock);
+        wake.wait(guard, [&]() { return group.pending == 0 || group.queued > 0; });
+    }
+}
+
+// Pop the newest task of our own deque, or steal from another one. A worker moves the older half of its victim's
+// tasks to its own deque and runs the newest of them; other threads steal a single task.
+bool ThreadPool::take(int index, pool_task &task) {
+    if (index != -1) {
+        worker_queue &own = *queues[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    int count = queues.size();
+    int start = index == -1 ? next_queue % count : index + 1;
+    for (int k = 0; k < count; k++) {
+        int victim_index = (start + k) % count;
+        if (victim_index == index) {
+            continue;
+        }
+        worker_queue &victim = *queues[victim_index];
+        std::deque<pool_task> stolen;
+        victim.lock.lock();
+        int half = index == -1 ? std::min<int>(victim.tasks.size(), 1) : (victim.tasks.size() + 1) / 2;
+        for (int n = 0; n < half; n++) {
+            stolen.push_back(std::move(victim.tasks.front()));
+            victim.tasks.pop_front();
+        }
+        victim.lock.unlock();
+        if (stolen.empty()) {
+            continue;
+        }
+        task = std::move(stolen.back());
+        stolen.pop_back();
+        if (!stolen.empty()) {
+            worker_queue &own = *queues[index];
+            std::lock_guard<std::mutex> guard(own.lock);
+            own.tasks.insert(own.tasks.begin(), std::make_move_iterator(stolen.begin()),
+                             std::make_move_iterator(stolen.end()));
+        }
+        return true;
+    }
+    return false;
+}
+
+// Take the newest task of the group from our own deque, or else the oldest from another one.
+bool ThreadPool::take_from(const task_group &group, int index, pool_task &task) {
+    int count = queues.size();
+    int start = index == -1 ? 0 : index;
+    for (int k = 0; k < count; k++) {
+        worker_queue &queue = *queues[(start + k) % count];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        auto is_group = [&](const pool_task &queued_task) { return queued_task.group == &group; };
+        auto found = queue.tasks.end();
+        if (k == 0 && index != -1) {
+            auto newest = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), is_group);
+            found = newest == queue.tasks.rend() ? queue.tasks.end() : std::prev(newest.base());
+        } else {
+            found = std::find_if(queue.tasks.begin(), queue.tasks.end(), is_group);
+        }
+        if (found != queue.tasks.end()) {
+            task = std::move(*found);
+            queue.tasks.erase(found);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Run a single queued task, of the group if one is given, if there is one.
+bool ThreadPool::run_one(int index, const task_group *group) {
+    pool_task task;
+    if (group != nullptr ? !take_from(*group, index, task) : !take(index, task)) {
+        return false;
+    }
+    queued--;
+    task.group->queued--;
+    task.run();
+    // Release what the task captured before the group counts it finished, since its waiter may then free whatever
+    // those captures point into.
+    task.run = nullptr;
+    if (--task.group->pending == 0) {
+        sleep_lock.lock();
+        sleep_lock.unlock();
+        wake.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::work(int index) {
+    current_pool = this;
+    current_index = index;
+    while (true) {
+        if (run_one(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(sleep_lock);
+        wake.wait(guard, [this]() { return stopping || queued > 0; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
+
+// Never destroyed: trees that outlive it, such as globals, still stop their pondering on it as they are destroyed.
+ThreadPool &shared_pool(int threads) {
+    static ThreadPool *pool = new ThreadPool(threads > 0 ? threads : std::max(1u, thread::hardware_concurrency()));
+    return *pool;
+}
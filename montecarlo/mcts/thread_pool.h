@@ -0,0 +1,62 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector, std::thread;
+
+// Counts the unfinished tasks of one caller, so it can wait for just its own work.
+typedef struct _task_group {
+    std::atomic<int> pending{0};
+    std::atomic<int> queued{0}; // Those not yet taken by any thread.
+} task_group;
+
+typedef struct _pool_task {
+    std::function<void()> run;
+    task_group *group;
+} pool_task;
+
+typedef struct _worker_queue {
+    std::mutex lock;
+    std::deque<pool_task> tasks;
+} worker_queue;
+
+// A fixed set of worker threads with one task deque each.
+// Workers push and pop their own tasks at the back, so nested work stays hot in cache, and an idle worker steals
+// the older half of another worker's deque from the front. Tasks from other threads are dealt round robin.
+// Threads waiting on a group run its queued tasks meanwhile, so tasks may wait on tasks they spawn, but never
+// anything else: a wait lasts as long as its own work, not whatever unrelated task it happened to pick up.
+class ThreadPool {
+  public:
+    ThreadPool(int threads);
+    ~ThreadPool();
+    void run(task_group &group, std::function<void()> task);
+    void wait(task_group &group);
+    int size() const { return workers.size(); }
+
+  private:
+    vector<std::unique_ptr<worker_queue>> queues;
+    vector<thread> workers;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    std::atomic<int> queued{0};
+    std::atomic<unsigned> next_queue{0};
+    bool stopping = false;
+    int self() const;
+    bool take(int self, pool_task &task);
+    bool take_from(const task_group &group, int self, pool_task &task);
+    bool run_one(int self, const task_group *group = nullptr);
+    void work(int index);
+};
+
+// The pool shared by the search and the tools. The first call creates it, with the given number of threads
+// or one per core when that is not positive; later calls ignore the count.
+ThreadPool &shared_pool(int threads = 0);
+
+#endif
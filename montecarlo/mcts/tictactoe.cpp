@@ -0,0 +1,39 @@
+#include "tictactoe.h"
+
+int TicTacToe::get_valid_moves(supergrid_coord moves[9]) const {
+    if (game_winner() != PLAYER_NONE) {
+        return 0;
+    }
+    int count = 0;
+    for (unsigned cells = TILE_TABLE[index].empty; cells != 0; cells &= cells - 1) {
+        int cell = __builtin_ctz(cells);
+        moves[count++] = supergrid_coord{cell / 3, cell % 3};
+    }
+    return count;
+}
+
+bool TicTacToe::is_valid_move(const supergrid_coord &move) const {
+    if (move.i < 0 || move.i > 2 || move.j < 0 || move.j > 2 || game_winner() != PLAYER_NONE) {
+        return false;
+    }
+    return (TILE_TABLE[index].empty >> move_index(move)) & 1;
+}
+
+// Play the move for the player to move. Returns false and leaves the board alone if it is illegal.
+bool TicTacToe::move(const supergrid_coord &move) {
+    if (!is_valid_move(move)) {
+        return false;
+    }
+    index += (player == PLAYER_X ? 1 : 2) * POW3[move_index(move)];
+    player = player == PLAYER_X ? PLAYER_O : PLAYER_X;
+    return true;
+}
+
+void TicTacToe::print() const {
+    for (int cell = 0, rest = index; cell < 9; cell++, rest /= 3) {
+        cout << "-XO"[rest % 3];
+        if (cell % 3 == 2) {
+            cout << endl;
+        }
+    }
+}
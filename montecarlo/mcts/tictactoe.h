@@ -0,0 +1,32 @@
+#ifndef TICTACTOE_H
+#define TICTACTOE_H
+#include "board.h"
+
+// Plain 3x3 tic-tac-toe, the smallest game the search runs on (see GameTree).
+// The whole position is one base-3 tile index, so every rule is a lookup in the ultimate board's TILE_TABLE.
+class TicTacToe {
+  public:
+    typedef supergrid_coord move_type;
+    static const int MAX_MOVES = 9;
+    static constexpr supergrid_coord NO_MOVE = {-1, -1};
+    static int move_index(const supergrid_coord &move) { return 3 * move.i + move.j; }
+    int get_valid_moves(supergrid_coord moves[9]) const;
+    char game_winner() const { return TILE_TABLE[index].winner; }
+    bool is_valid_move(const supergrid_coord &move) const;
+    bool move(const supergrid_coord &move);
+    void print() const;
+    bool operator==(const TicTacToe &other) const { return index == other.index; }
+    // The index is already a perfect hash, so both of these are exact.
+    unsigned long long key() const { return index; }
+    unsigned long long check() const { return index; }
+    unsigned short index = 0;
+    char player = PLAYER_X;
+};
+
+namespace std {
+template <> struct hash<TicTacToe> {
+    // The side to move follows from the index, so the index alone identifies the position.
+    size_t operator()(const TicTacToe &board) const { return board.index; }
+};
+} // namespace std
+#endif
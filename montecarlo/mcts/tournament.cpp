@@ -0,0 +1,214 @@
+// Native self-play tournament between two engine configurations.
+// Build: g++ -O2 -std=c++17 -pthread -mavx2 -mfma tournament.cpp board.cpp epoch.cpp mcts.cpp node_arena.cpp nn.cpp ntuple.cpp thread_pool.cpp tictactoe.cpp -o tournament
+// Usage: ./tournament games=1000 threads=8 a.iterations=10000 b.iterations=5000 b.c=1.2 b.rollout=greedy
+// Engine settings are iterations, time_ms, c, rollout (random|greedy), max_nodes, network or ntuple (a weight file),
+// eval_weight, rollout_depth, batch_size, ponder (0|1), parallel (0|1), selection (puct|uct|ucb1tuned),
+// reward (wtl|contempt), backup (path|graph) and compact_below, prefixed by a. or b.
+// Games and parallel searches share one pool of threads workers, and the main thread plays games too while it waits.
+#include "board.h"
+#include "mcts.h"
+#include "nn.h"
+#include "ntuple.h"
+#include <string>
+
+using std::string, std::mutex;
+
+typedef struct _engine_stats {
+    long long moves = 0;
+    double seconds = 0;
+    double bytes = 0;
+} engine_stats;
+
+// Storage for whichever evaluator an engine loads.
+typedef struct _engine_evaluators {
+    NetworkEvaluator network;
+    NTupleEvaluator ntuple;
+} engine_evaluators;
+
+typedef struct _tournament_result {
+    int wins = 0;
+    int ties = 0;
+    int losses = 0;
+    engine_stats a;
+    engine_stats b;
+} tournament_result;
+
+bool parse_setting(search_config &config, engine_evaluators &evaluators, const string &key, const string &value) {
+    if (key == "iterations") {
+        config.iterations = std::stoi(value);
+    } else if (key == "time_ms") {
+        config.time_ms = std::stoi(value);
+    } else if (key == "c") {
+        config.c = std::stof(value);
+    } else if (key == "max_nodes") {
+        config.max_nodes = std::stoul(value);
+    } else if (key == "batch_size") {
+        config.batch_size = std::stoi(value);
+    } else if (key == "eval_weight") {
+        config.eval_weight = std::stof(value);
+    } else if (key == "compact_below") {
+        config.compact_below = std::stof(value);
+    } else if (key == "rollout_depth") {
+        config.rollout_depth = std::stoi(value);
+    } else if (key == "network") {
+        if (!evaluators.network.load(value.c_str())) {
+            return false;
+        }
+        config.evaluator = &evaluators.network;
+    } else if (key == "ntuple") {
+        if (!evaluators.ntuple.load(value.c_str())) {
+            return false;
+        }
+        config.evaluator = &evaluators.ntuple;
+    } else if (key == "ponder") {
+        config.ponder = std::stoi(value) != 0;
+    } else if (key == "parallel") {
+        config.parallel = std::stoi(value) != 0;
+    } else if (key == "rollout" && value == "random") {
+        config.rollout = ROLLOUT_RANDOM;
+    } else if (key == "rollout" && value == "greedy") {
+        config.rollout = ROLLOUT_GREEDY;
+    } else if (key == "selection" && value == "puct") {
+        config.selection = SELECT_PUCT;
+    } else if (key == "selection" && value == "uct") {
+        config.selection = SELECT_UCT;
+    } else if (key == "selection" && value == "ucb1tuned") {
+        config.selection = SELECT_UCB1_TUNED;
+    } else if (key == "reward" && value == "wtl") {
+        config.reward = REWARD_WIN_TIE_LOSS;
+    } else if (key == "reward" && value == "contempt") {
+        config.reward = REWARD_CONTEMPT;
+    } else if (key == "backup" && value == "path") {
+        config.backup = BACKUP_PATH;
+    } else if (key == "backup" && value == "graph") {
+        config.backup = BACKUP_GRAPH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Play a single game between A and B and return the result from A's point of view:
+// 1 for a win, 0 for a tie and -1 for a loss.
+int play_game(const search_config &a, const search_config &b, bool a_first, engine_stats &a_stats,
+              engine_stats &b_stats) {
+    MCTSTree a_tree, b_tree;
+    a_tree.config = a;
+    b_tree.config = b;
+    a_tree.verbose = false;
+    b_tree.verbose = false;
+    char a_player = a_first ? PLAYER_X : PLAYER_O;
+    Board board;
+    while (board.game_winner() == PLAYER_NONE) {
+        bool a_to_move = board.player == a_player;
+        MCTSTree &tree = a_to_move ? a_tree : b_tree;
+        engine_stats &stats = a_to_move ? a_stats : b_stats;
+        auto start = std::chrono::steady_clock::now();
+        grid_coord move = tree.choose_move(board);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        stats.moves++;
+        stats.seconds += elapsed.count();
+        stats.bytes += tree.memory_usage();
+        if (!board.move(move)) {
+            printf("Engine %c returned illegal move (%d, %d, %d, %d)!\n", a_to_move ? 'A' : 'B', move.m_i, move.m_j,
+                   move.i, move.j);
+            return a_to_move ? -1 : 1;
+        }
+        if (tree.config.ponder) {
+            tree.start_pondering(board);
+        }
+    }
+    char winner = board.game_winner();
+    if (winner == PLAYER_TIE) {
+        return 0;
+    }
+    return winner == a_player ? 1 : -1;
+}
+
+// Convert an expected score in (0, 1) to an Elo difference.
+double elo(double score) {
+    score = std::clamp(score, 1e-4, 1 - 1e-4);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+void print_stats(const char *name, const engine_stats &stats) {
+    double moves = stats.moves > 0 ? stats.moves : 1;
+    printf("%s: %.2f ms/move, %.1f KiB/move over %lld moves\n", name, 1000.0 * stats.seconds / moves,
+           stats.bytes / moves / 1024.0, stats.moves);
+}
+
+int main(int argc, char **argv) {
+    search_config a, b;
+    engine_evaluators a_evaluators, b_evaluators;
+    int games = 100;
+    int threads = thread::hardware_concurrency();
+    for (int arg = 1; arg < argc; arg++) {
+        string setting(argv[arg]);
+        size_t eq = setting.find('=');
+        if (eq == string::npos) {
+            printf("Ignoring malformed setting %s\n", argv[arg]);
+            continue;
+        }
+        string key = setting.substr(0, eq);
+        string value = setting.substr(eq + 1);
+        bool ok = true;
+        if (key == "games") {
+            games = std::stoi(value);
+        } else if (key == "threads") {
+            threads = std::stoi(value);
+        } else if (key.rfind("a.", 0) == 0) {
+            ok = parse_setting(a, a_evaluators, key.substr(2), value);
+        } else if (key.rfind("b.", 0) == 0) {
+            ok = parse_setting(b, b_evaluators, key.substr(2), value);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            printf("Unknown setting %s\n", argv[arg]);
+            return 1;
+        }
+    }
+    threads = threads < 1 ? 1 : threads;
+
+    tournament_result result;
+    mutex result_lock;
+    ThreadPool &pool = shared_pool(threads);
+    task_group all_games;
+    for (int game = 0; game < games; game++) {
+        pool.run(all_games, [&, game]() {
+            engine_stats a_stats, b_stats;
+            int outcome = play_game(a, b, game % 2 == 0, a_stats, b_stats);
+            result_lock.lock();
+            result.wins += outcome == 1;
+            result.ties += outcome == 0;
+            result.losses += outcome == -1;
+            result.a.moves += a_stats.moves;
+            result.a.seconds += a_stats.seconds;
+            result.a.bytes += a_stats.bytes;
+            result.b.moves += b_stats.moves;
+            result.b.seconds += b_stats.seconds;
+            result.b.bytes += b_stats.bytes;
+            int played = result.wins + result.ties + result.losses;
+            if (played % 10 == 0) {
+                printf("%d/%d games: +%d =%d -%d\n", played, games, result.wins, result.ties, result.losses);
+            }
+            result_lock.unlock();
+        });
+    }
+    pool.wait(all_games);
+
+    int n = result.wins + result.ties + result.losses;
+    if (n == 0) {
+        return 0;
+    }
+    double score = (result.wins + 0.5 * result.ties) / n;
+    double variance = (result.wins * (1 - score) * (1 - score) + result.ties * (0.5 - score) * (0.5 - score) +
+                       result.losses * score * score) /
+                      n;
+    double margin = 1.96 * sqrt(variance / n);
+    printf("A vs B: +%d =%d -%d (score %.3f)\n", result.wins, result.ties, result.losses, score);
+    printf("Elo difference: %.1f (95%% CI %.1f to %.1f)\n", elo(score), elo(score - margin), elo(score + margin));
+    print_stats("A", result.a);
+    print_stats("B", result.b);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include "training_data.h"
+
+void pack_board(const Board &board, training_record &record) {
+    for (int tile = 0; tile < 9; tile++) {
+        record.tiles[tile] = board.tile_index[tile / 3][tile % 3];
+    }
+    bool forced = board.major_tile.i != -1;
+    record.forced_tile = forced ? 3 * board.major_tile.i + board.major_tile.j : -1;
+    record.player = board.player;
+    record.reserved = 0;
+}
+
+Board unpack_board(const training_record &record) {
+    char grid[9][9];
+    for (int tile = 0; tile < 9; tile++) {
+        for (int cell = 0, rest = record.tiles[tile]; cell < 9; cell++, rest /= 3) {
+            int digit = rest % 3;
+            char owner = digit == 0 ? PLAYER_NONE : (digit == 1 ? PLAYER_X : PLAYER_O);
+            grid[3 * (tile / 3) + cell / 3][3 * (tile % 3) + cell % 3] = owner;
+        }
+    }
+    supergrid_coord major_tile = {-1, -1};
+    if (record.forced_tile != -1) {
+        major_tile = {record.forced_tile / 3, record.forced_tile % 3};
+    }
+    return Board(grid, record.player, major_tile);
+}
+
+bool write_records(FILE *file, const training_record *records, int count) {
+    return fwrite(records, sizeof(training_record), count, file) == count;
+}
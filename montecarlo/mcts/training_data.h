@@ -0,0 +1,27 @@
+#ifndef TRAINING_DATA_H
+#define TRAINING_DATA_H
+#include "board.h"
+#include <stdio.h>
+
+// One position from a self-play game, as written by the selfplay tool.
+// Records are fixed width with no file header, so files can be appended to or concatenated freely and
+// memory-mapped as a plain array of records. Fields are in the native (little-endian) byte order.
+typedef struct _training_record {
+    unsigned short tiles[9];   // Base-3 index of every tile (see Board::tile_index), tile 3 * m_i + m_j.
+    signed char forced_tile;   // 3 * i + j of Board::major_tile, or -1 when it is unset.
+    signed char player;        // The side to move, PLAYER_X or PLAYER_O.
+    signed char result;        // How the game ended for the side to move: 1 won, 0 tied, -1 lost.
+    unsigned char reserved;    // Always 0.
+    unsigned short visits[81]; // Root visits per cell, indexed 9 * row + column and scaled to sum to at most 65535.
+} training_record;
+
+static_assert(sizeof(training_record) == 184, "training_record must stay fixed width");
+
+// Fill the board fields of a record. The result and visits are left alone.
+void pack_board(const Board &board, training_record &record);
+// The board a record was packed from.
+Board unpack_board(const training_record &record);
+// Append records to an open file. Returns false if they could not all be written.
+bool write_records(FILE *file, const training_record *records, int count);
+
+#endif
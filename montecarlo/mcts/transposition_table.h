@@ -0,0 +1,122 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+#include <functional>
+#include <vector>
+
+// The slot of no entry.
+const unsigned NO_SLOT = ~0u;
+
+// A hash map whose entries sit at fixed slots, numbered from 0, for as long as they are in the table. Callers hash a
+// key once with hash() and hand that to find and insert, and can keep the slot an entry landed in to read or erase
+// it later without hashing the key again. Erased slots are reused by later inserts.
+// Each entry keeps its key's hash, so growing the table never rehashes a key either.
+template <typename Key, typename Value> class TranspositionTable {
+  public:
+    size_t hash(const Key &key) const { return std::hash<Key>()(key); }
+
+    // Returns the slot holding key, or NO_SLOT.
+    unsigned find(const Key &key, size_t hash) const {
+        if (buckets.empty()) {
+            return NO_SLOT;
+        }
+        for (unsigned slot = buckets[bucket(hash)]; slot != NO_SLOT; slot = entries[slot].next) {
+            if (entries[slot].hash == hash && entries[slot].key == key) {
+                return slot;
+            }
+        }
+        return NO_SLOT;
+    }
+
+    // Add an entry for a key that is not in the table yet, returning its slot.
+    unsigned insert(const Key &key, size_t hash, const Value &value) {
+        if (count >= buckets.size()) {
+            grow();
+        }
+        unsigned slot = free_slots;
+        if (slot == NO_SLOT) {
+            slot = entries.size();
+            entries.emplace_back();
+        } else {
+            free_slots = entries[slot].next;
+        }
+        table_entry &entry = entries[slot];
+        entry.key = key;
+        entry.value = value;
+        entry.hash = hash;
+        entry.used = true;
+        entry.next = buckets[bucket(hash)];
+        buckets[bucket(hash)] = slot;
+        count++;
+        return slot;
+    }
+
+    // Remove the entry at slot, which must be in use. Only walks the entries that share its bucket.
+    void erase(unsigned slot) {
+        unsigned *link = &buckets[bucket(entries[slot].hash)];
+        while (*link != slot) {
+            link = &entries[*link].next;
+        }
+        *link = entries[slot].next;
+        entries[slot].value = Value();
+        entries[slot].used = false;
+        entries[slot].next = free_slots;
+        free_slots = slot;
+        count--;
+    }
+
+    Value &operator[](unsigned slot) { return entries[slot].value; }
+    size_t size() const { return count; }
+
+    // Call visit(slot, value) for every entry.
+    template <typename Visit> void for_each(Visit visit) {
+        for (unsigned slot = 0; slot < entries.size(); slot++) {
+            if (entries[slot].used) {
+                visit(slot, entries[slot].value);
+            }
+        }
+    }
+
+    // The first entry in the bucket of hash, for prefetching ahead of a find, or nullptr when the bucket is empty.
+    const void *bucket_head(size_t hash) const {
+        if (buckets.empty() || buckets[bucket(hash)] == NO_SLOT) {
+            return nullptr;
+        }
+        return &entries[buckets[bucket(hash)]];
+    }
+
+    size_t memory_usage() const {
+        return entries.capacity() * sizeof(table_entry) + buckets.capacity() * sizeof(unsigned);
+    }
+
+  private:
+    typedef struct _table_entry {
+        Key key;
+        Value value;
+        size_t hash;
+        unsigned next; // The next slot in the same bucket, or in the free list once erased.
+        bool used = false;
+    } table_entry;
+
+    std::vector<table_entry> entries;
+    std::vector<unsigned> buckets; // The first slot in each bucket. A power of two of them.
+    int bucket_bits = 0;
+    unsigned free_slots = NO_SLOT;
+    size_t count = 0;
+
+    // Fibonacci hashing, so that weak low bits, as in hashes that are just an index, still spread over the buckets.
+    size_t bucket(size_t hash) const { return ((unsigned long long)hash * 0x9E3779B97F4A7C15ull) >> (64 - bucket_bits); }
+
+    // Double the buckets, keeping the table at no more than one entry per bucket.
+    void grow() {
+        bucket_bits = buckets.empty() ? 10 : bucket_bits + 1;
+        buckets.assign((size_t)1 << bucket_bits, NO_SLOT);
+        for (unsigned slot = 0; slot < entries.size(); slot++) {
+            if (entries[slot].used) {
+                entries[slot].next = buckets[bucket(entries[slot].hash)];
+                buckets[bucket(entries[slot].hash)] = slot;
+            }
+        }
+    }
+};
+
+#endif